@@ -0,0 +1,46 @@
+#version 450
+#pragma shader_stage(vertex)
+#extension GL_EXT_spec_constant_composites: enable
+#extension GL_EXT_shader_8bit_storage: require
+#extension GL_EXT_shader_explicit_arithmetic_types: require
+#extension GL_EXT_buffer_reference: require
+#extension GL_EXT_shader_explicit_arithmetic_types_int64: require
+#extension GL_GOOGLE_include_directive: require
+
+#include "shared_structs.glsl"
+
+layout (set = 0, binding = 0) uniform SceneGlobals {
+    mat4x4 camera_view;
+    mat4x4 camera_projection;
+    vec3 position;
+} sceneInfo;
+
+layout (push_constant) uniform PushConstant {
+    mat4 model;
+    uint diffuse_texture_index;
+    uint normal_texture_index;
+    uint metalness_texture_index;
+    bool decompressed_normals;
+    vec3 position_offset;
+    uint vertex_format;
+    vec3 position_scale;
+} pc;
+
+// PackedVertex, the formats are set in PackedVertex::get_attribute_descriptions
+layout (location = 0) in vec4 inPosition;
+layout (location = 1) in vec2 inTexCoord;
+layout (location = 2) in vec2 inNormal;
+layout (location = 3) in vec2 inTangent;
+
+layout (location = 0) out vec2 fragTexCoord;
+layout (location = 1) out vec3 normalCoord;
+layout (location = 2) out vec3 outTangent;
+
+
+void main() {
+    vec3 position = pc.position_offset + inPosition.xyz * pc.position_scale;
+    gl_Position = sceneInfo.camera_projection * sceneInfo.camera_view * pc.model * vec4(position, 1.0);
+    fragTexCoord = inTexCoord;
+    normalCoord = vec3(pc.model * vec4(decode_octahedral(inNormal), 0.0));
+    outTangent = vec3(pc.model * vec4(decode_octahedral(inTangent), 0.0));
+}
@@ -1,4 +1,5 @@
 #extension GL_GOOGLE_cpp_style_line_directive: require
+#extension GL_EXT_scalar_block_layout: require
 
 #ifndef SHARED
 #define SHARED
@@ -34,11 +35,55 @@ struct Vertex {
     vec3 tangent;
 };
 
-struct Meshlet {
-    uint vertex_offset;
+#define VERTEX_FORMAT_FULL 0
+#define VERTEX_FORMAT_PACKED 1
+
+// Strides for shaders that read the vertex buffer as raw uints
+#define VERTEX_STRIDE_WORDS 16
+#define PACKED_VERTEX_STRIDE_WORDS 5
+
+// See PackedVertex in Vertex.h
+struct PackedVertex {
+    uint position_xy; // unorm16 x2 relative to the mesh bounds
+    uint position_z; // unorm16, high half unused
+    uint normal; // octahedral snorm16 x2
+    uint tangent; // octahedral snorm16 x2
+    uint tex_coord; // half x2
+};
+
+// Where a model's sections start in the scene wide geometry buffers, see ModelGeometry in PVPScene.h.
+// Meshlet headers hold offsets inside the model's sections, these go on top
+struct ModelGeometry {
+    uint vertex_offset; // In words
+    uint meshlet_offset; // Also the first sphere bounds
+    uint meshlet_vertices_offset;
     uint triangle_offset;
+    uint meshlet_count; // Full detail
+};
+
+// Meshlet limits the scene was imported with and the mesh workgroup size, set per pipeline by PvpScene::get_meshlet_defines
+#ifndef MESHLET_MAX_VERTICES
+#define MESHLET_MAX_VERTICES 64
+#endif
+#ifndef MESHLET_MAX_TRIANGLES
+#define MESHLET_MAX_TRIANGLES 126
+#endif
+#ifndef MESH_GROUP_SIZE
+#define MESH_GROUP_SIZE 128
+#endif
+
+// See GpuMeshlet in ModelData.h
+struct PackedMeshlet {
+    uint vertex_data; // offset:24, count - 1:7, 16 bit meshlet vertices:1
+    uint triangle_data; // offset:24, count - 1:8
+};
+
+struct MeshletHeader {
+    uint vertex_offset;
     uint vertex_count;
+    uint triangle_offset;
     uint triangle_count;
+    bool short_vertices;
 };
 
 struct DrawCommand
@@ -48,11 +93,14 @@ struct DrawCommand
     uint group_count_z;
     uint meshlet_offset;
     uint meshlet_count;
+    uint model_index; // Shared geometry drawn by this instance, indexes MeshletsBuffers
+    uint lod_meshlet_count; // meshlet_count plus the simplified meshlets behind them
 };
 
 #define AS_GROUP_SIZE 32
 struct Payload {
     uint meshlet_indices[AS_GROUP_SIZE];
+    uint instance_index; // Draw index, indexes ModelInfo
     uint model_index;
 };
 
@@ -77,11 +125,26 @@ struct RadarCull
     float sphere_factor_x;
 };
 
+// See ConeBounds in ModelData.h. 20 bytes, buffers holding it use the scalar layout
+struct PackedConeBounds {
+    vec4 sphere_bounds;
+    uint cone; // snorm8 axis xyz and cutoff
+};
+
+// World space bounds decoded by TransformCone
 struct ConeBounds {
     vec4 sphere_bounds;
     vec4 cone_axis;
 };
 
+// See MeshletLod in ModelData.h
+struct MeshletLod {
+    vec4 bounds; // Sphere around the group this meshlet was simplified from
+    vec4 parent_bounds; // Sphere around the group simplified from this meshlet
+    float error;
+    float parent_error;
+};
+
 struct SceneGlobals {
     mat4x4 camera_view;
     mat4x4 camera_projection;
@@ -90,6 +153,7 @@ struct SceneGlobals {
     mat4x4 camera_projection_view;
     RadarCull rader_cull;
     int cull_mode;
+    float lod_error_scale; // 0 when LOD selection is off
 };
 
 struct ModelInfo {
@@ -98,26 +162,39 @@ struct ModelInfo {
     uint normal_texture_index;
     uint metalness_texture_index;
     bool decompressed_normals;
+    vec3 position_offset;
+    uint vertex_format;
+    vec3 position_scale;
 };
 
 layout (std430, buffer_reference, buffer_reference_align = 8) buffer VertexReference {
     Vertex vertex_data[];
 };
 
+layout (std430, buffer_reference, buffer_reference_align = 4) buffer PackedVertexReference {
+    PackedVertex vertex_data[];
+};
+
 layout (std430, buffer_reference, buffer_reference_align = 8) buffer MeshLetReference {
-    Meshlet meshlet_data[];
+    PackedMeshlet meshlet_data[];
 };
 
+// One triangle per uint, see decode_meshlet_triangle
 layout (std430, buffer_reference, buffer_reference_align = 8) buffer TriangleIndicesReference {
-    uint8_t triangle_indices_data[];
+    uint triangle_indices_data[];
 };
 
+// Two vertex indices per uint for short_vertices meshlets, see meshlet_vertex_word
 layout (std430, buffer_reference, buffer_reference_align = 8) buffer MeshLetVertexReference {
     uint meshlet_vertex_data[];
 };
 
-layout (std430, buffer_reference, buffer_reference_align = 8) buffer ConeDataReference {
-    ConeBounds cone_data[];
+layout (scalar, buffer_reference, buffer_reference_align = 4) buffer ConeDataReference {
+    PackedConeBounds cone_data[];
+};
+
+layout (std430, buffer_reference, buffer_reference_align = 8) buffer MeshletLodReference {
+    MeshletLod lod_data[];
 };
 
 layout (std430, buffer_reference, buffer_reference_align = 8) buffer ModelInfoReference {
@@ -131,8 +208,73 @@ struct MeshletsBuffers
     MeshLetVertexReference meshlet_vertices_data;
     TriangleIndicesReference meshlet_triangle_data;
     ConeDataReference meshlet_sphere_bounds_data;
+    MeshletLodReference meshlet_lod_data;
 };
 
+MeshletHeader decode_meshlet(PackedMeshlet packed)
+{
+    MeshletHeader header;
+    header.vertex_offset = packed.vertex_data & 0xFFFFFFu;
+    header.vertex_count = ((packed.vertex_data >> 24) & 0x7Fu) + 1u;
+    header.short_vertices = (packed.vertex_data & 0x80000000u) != 0u;
+    header.triangle_offset = packed.triangle_data & 0xFFFFFFu;
+    header.triangle_count = (packed.triangle_data >> 24) + 1u;
+    return header;
+}
+
+uvec3 decode_meshlet_triangle(uint packed)
+{
+    return uvec3(packed & 0xFFu, (packed >> 8) & 0xFFu, (packed >> 16) & 0xFFu);
+}
+
+// Word of the meshlet vertex buffer holding the vertex index of local vertex i
+uint meshlet_vertex_word(MeshletHeader header, uint i)
+{
+    uint element = header.vertex_offset + i;
+    return header.short_vertices ? element >> 1 : element;
+}
+
+uint decode_meshlet_vertex(MeshletHeader header, uint i, uint word)
+{
+    uint shift = ((header.vertex_offset + i) & 1u) * 16u;
+    return header.short_vertices ? (word >> shift) & 0xFFFFu : word;
+}
+
+vec3 decode_octahedral(vec2 encoded)
+{
+    vec3 direction = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-direction.z, 0.0);
+    direction.x += direction.x >= 0.0 ? -fold : fold;
+    direction.y += direction.y >= 0.0 ? -fold : fold;
+    return normalize(direction);
+}
+
+vec3 decode_packed_position(uint position_xy, uint position_z, vec3 position_offset, vec3 position_scale)
+{
+    return position_offset + vec3(unpackUnorm2x16(position_xy), unpackUnorm2x16(position_z).x) * position_scale;
+}
+
+Vertex decode_vertex(PackedVertex packed, vec3 position_offset, vec3 position_scale)
+{
+    Vertex vertex;
+    vertex.position = decode_packed_position(packed.position_xy, packed.position_z, position_offset, position_scale);
+    vertex.tex_coord = unpackHalf2x16(packed.tex_coord);
+    vertex.normal = decode_octahedral(unpackSnorm2x16(packed.normal));
+    vertex.tangent = decode_octahedral(unpackSnorm2x16(packed.tangent));
+    return vertex;
+}
+
+// The vertex buffer of a model holds either Vertex or PackedVertex depending on ModelInfo.vertex_format
+Vertex load_vertex(VertexReference vertices, ModelInfo model_info, uint index)
+{
+    if (model_info.vertex_format == VERTEX_FORMAT_PACKED)
+    {
+        PackedVertexReference packed_vertices = PackedVertexReference(uint64_t(vertices));
+        return decode_vertex(packed_vertices.vertex_data[index], model_info.position_offset, model_info.position_scale);
+    }
+    return vertices.vertex_data[index];
+}
+
 uint hash(uint a)
 {
     a = (a + 0x7ed55d16) + (a << 12);
@@ -84,7 +84,30 @@ bool IsVisible(ConeBounds cone) {
     return true;
 }
 
-ConeBounds TransformCone(ConeBounds cone, mat4 matrix) {
+// Simplification error of a sphere in pixels over the LOD threshold
+float ProjectedError(vec4 sphere, float error) {
+    float distance = max(length(sphere.xyz - sceneInfo.position) - sphere.w, sceneInfo.rader_cull.near_plane);
+    return error / distance * sceneInfo.lod_error_scale;
+}
+
+// Every meshlet decides on its own. Siblings share their bounds so a whole group switches level at once.
+bool SelectLod(MeshletLod lod, mat4 matrix) {
+    if (sceneInfo.lod_error_scale == 0.0) {
+        return lod.error == 0.0;
+    }
+
+    float maxScale = max(max(length(matrix[0].xyz), length(matrix[1].xyz)), length(matrix[2].xyz));
+    vec4 bounds = vec4(vec3(matrix * vec4(lod.bounds.xyz, 1.0f)), lod.bounds.w * maxScale);
+    vec4 parent_bounds = vec4(vec3(matrix * vec4(lod.parent_bounds.xyz, 1.0f)), lod.parent_bounds.w * maxScale);
+
+    return ProjectedError(bounds, lod.error * maxScale) <= 1.0 && ProjectedError(parent_bounds, lod.parent_error * maxScale) > 1.0;
+}
+
+ConeBounds TransformCone(PackedConeBounds packed, mat4 matrix) {
+    ConeBounds cone;
+    cone.sphere_bounds = packed.sphere_bounds;
+    cone.cone_axis = unpackSnorm4x8(packed.cone);
+
     vec3 scale = vec3(
     length(matrix[0].xyz),
     length(matrix[1].xyz),
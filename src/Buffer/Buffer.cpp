@@ -1,5 +1,7 @@
 ﻿#include "Buffer.h"
 
+#include "BufferPool.h"
+
 #include <span>
 #include <VMAAllocator/VmaAllocator.h>
 #include <spdlog/spdlog.h>
@@ -7,14 +9,29 @@
 
 void pvp::Buffer::copy_from_buffer(VkCommandBuffer command_buffer, Buffer& source, const VkBufferCopy& copy_region) const
 {
-    vkCmdCopyBuffer(command_buffer, source.m_buffer, m_buffer, 1, &copy_region);
+    const VkBufferCopy region{ source.m_offset + copy_region.srcOffset, m_offset + copy_region.dstOffset, copy_region.size };
+    vkCmdCopyBuffer(command_buffer, source.m_buffer, m_buffer, 1, &region);
 }
 void pvp::Buffer::copy_from_buffer(VkCommandBuffer command_buffer, Buffer& source) const
 {
     copy_from_buffer(command_buffer, source, VkBufferCopy{ 0, 0, get_size() });
 }
 
+void pvp::Buffer::flush(VkDeviceSize offset, VkDeviceSize size) const
+{
+    if (size == VK_WHOLE_SIZE)
+    {
+        size = m_buffer_size - offset;
+    }
+    vmaFlushAllocation(m_allocator, m_allocation, m_offset + offset, size);
+}
+
 void pvp::Buffer::destroy() const
 {
+    if (m_pool != nullptr)
+    {
+        m_pool->free(m_pool_block, m_virtual_allocation);
+        return;
+    }
     vmaDestroyBuffer(m_allocator, m_buffer, m_allocation);
 }
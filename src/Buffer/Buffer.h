@@ -11,6 +11,10 @@
 
 namespace pvp
 {
+    class BufferPool;
+
+    // Either a VkBuffer and allocation of its own, or a range of a BufferPool block. Pooled buffers share the
+    // VkBuffer and allocation, so anything passing them to Vulkan adds get_offset()
     class Buffer final
     {
     public:
@@ -25,16 +29,35 @@ namespace pvp
             return m_buffer;
         }
 
+        // Shared by the whole block when pooled, flush() takes care of the offset
         [[nodiscard]] const VmaAllocation& get_allocation() const
         {
             return m_allocation;
         }
 
+        // pMappedData, offset and size already describe the buffer's own range
         [[nodiscard]] const VmaAllocationInfo& get_allocation_info() const
         {
             return m_allocation_info;
         }
 
+        // Where the buffer starts in get_buffer(), zero unless pooled
+        [[nodiscard]] VkDeviceSize get_offset() const
+        {
+            return m_offset;
+        }
+
+        // Zero unless built with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+        [[nodiscard]] VkDeviceAddress get_device_address() const
+        {
+            return m_device_address;
+        }
+
+        [[nodiscard]] bool is_pooled() const
+        {
+            return m_pool != nullptr;
+        }
+
         [[nodiscard]] VkDeviceSize get_size() const
         {
             return m_buffer_size;
@@ -45,29 +68,24 @@ namespace pvp
         {
             memcpy(m_allocation_info.pMappedData, input_data.data(), input_data.size_bytes());
         };
-        template<typename T>
-        void copy_data_from_tmp_buffer(Context& context, VkCommandBuffer command_buffer, const std::span<T> input_data, DestructorQueue& destructor_queue) const
-        {
-            Buffer tmp_buffer{};
-            BufferBuilder()
-                .set_size(input_data.size_bytes())
-                .set_usage(VK_BUFFER_USAGE_TRANSFER_SRC_BIT)
-                .set_flags(VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT)
-                .set_memory_usage(VMA_MEMORY_USAGE_AUTO_PREFER_HOST)
-                .build(context.allocator->get_allocator(), tmp_buffer);
-            destructor_queue.add_to_queue([tmp_buffer] { tmp_buffer.destroy(); });
-
-            tmp_buffer.copy_data_into_buffer(input_data);
-            copy_from_buffer(command_buffer, tmp_buffer);
-        };
+        // Offset and size are relative to the buffer, VK_WHOLE_SIZE flushes up to its end
+        void flush(VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE) const;
+        // Uploads into device local buffers go through a StagingUploader
 
     private:
         friend class BufferBuilder;
+        friend class BufferPool;
         VkBuffer           m_buffer{ VK_NULL_HANDLE };
         VmaAllocator       m_allocator{ VK_NULL_HANDLE };
         VmaAllocation      m_allocation{ VK_NULL_HANDLE };
         VmaAllocationInfo  m_allocation_info{};
         VkBufferCreateInfo m_create_info{};
         VkDeviceSize       m_buffer_size{};
+        VkDeviceSize       m_offset{};
+        VkDeviceAddress    m_device_address{};
+
+        BufferPool*          m_pool{};
+        uint32_t             m_pool_block{};
+        VmaVirtualAllocation m_virtual_allocation{ VK_NULL_HANDLE };
     };
 } // namespace pvp
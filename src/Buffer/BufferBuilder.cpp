@@ -1,6 +1,7 @@
 ﻿#include "BufferBuilder.h"
 
 #include "Buffer.h"
+#include "BufferPool.h"
 #include <exception>
 #include <stdexcept>
 
@@ -26,6 +27,11 @@ namespace pvp
         m_flags = flags;
         return *this;
     }
+    BufferBuilder& BufferBuilder::set_pool(BufferPool& pool)
+    {
+        m_pool = &pool;
+        return *this;
+    }
     void BufferBuilder::build(const VmaAllocator& allocator, Buffer& buffer) const
     {
         VkBufferCreateInfo create_info{};
@@ -39,6 +45,18 @@ namespace pvp
         allocation_create_info.flags = m_flags;
         allocation_create_info.pUserData = (void*)"data buffer";
 
+        if (m_pool != nullptr && m_buffer_size <= m_pool->get_max_pooled_size())
+        {
+            if ((m_buffer_usage & ~m_pool->get_usage()) != 0)
+            {
+                throw std::runtime_error("Buffer usage not supported by its pool");
+            }
+            m_pool->allocate(m_buffer_size, buffer);
+            buffer.m_buffer_size = m_buffer_size;
+            buffer.m_create_info = create_info;
+            return;
+        }
+
         if (vmaCreateBuffer(allocator, &create_info, &allocation_create_info, &buffer.m_buffer, &buffer.m_allocation, &buffer.m_allocation_info) != VK_SUCCESS)
         {
             throw std::runtime_error("Can't create buffer");
@@ -47,5 +65,16 @@ namespace pvp
         buffer.m_allocator = allocator;
         buffer.m_buffer_size = m_buffer_size;
         buffer.m_create_info = create_info;
+        buffer.m_offset = 0;
+        buffer.m_device_address = 0;
+        buffer.m_pool = nullptr;
+
+        if (m_buffer_usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT)
+        {
+            VmaAllocatorInfo allocator_info{};
+            vmaGetAllocatorInfo(allocator, &allocator_info);
+            const VkBufferDeviceAddressInfo address_info{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, .buffer = buffer.m_buffer };
+            buffer.m_device_address = vkGetBufferDeviceAddress(allocator_info.device, &address_info);
+        }
     }
 } // namespace pvp
\ No newline at end of file
@@ -6,6 +6,7 @@ namespace pvp
 {
 
     class Buffer;
+    class BufferPool;
 
     class BufferBuilder final
     {
@@ -16,6 +17,9 @@ namespace pvp
         BufferBuilder& set_usage(VkBufferUsageFlags buffer_usage);
         BufferBuilder& set_memory_usage(VmaMemoryUsage usage);
         BufferBuilder& set_flags(VmaAllocationCreateFlags flags);
+        // Suballocates from pool instead of creating a VkBuffer, unless the size is above what the pool takes. The usage
+        // has to be a subset of the pool's, memory usage and flags only apply when the buffer ends up on its own
+        BufferBuilder& set_pool(BufferPool& pool);
 
         void build(const VmaAllocator& allocator, Buffer& buffer) const;
 
@@ -24,5 +28,6 @@ namespace pvp
         VkBufferUsageFlags       m_buffer_usage{ 0 };
         VmaMemoryUsage           m_usage{ VMA_MEMORY_USAGE_AUTO };
         VmaAllocationCreateFlags m_flags{};
+        BufferPool*              m_pool{};
     };
 } // namespace pvp
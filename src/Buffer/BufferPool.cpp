@@ -0,0 +1,119 @@
+﻿#include "BufferPool.h"
+
+#include "BufferBuilder.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <tracy/Tracy.hpp>
+
+pvp::BufferPool::BufferPool(const VmaAllocator& allocator, VkBufferUsageFlags usage, VmaMemoryUsage memory_usage, VmaAllocationCreateFlags flags, VkDeviceSize block_size)
+    : m_allocator{ allocator }
+    , m_usage{ usage }
+    , m_memory_usage{ memory_usage }
+    , m_flags{ flags }
+    , m_block_size{ block_size }
+{
+    // Every range can be bound as a descriptor, used as an index or indirect buffer or read through its address
+    const VkPhysicalDeviceProperties* properties{};
+    vmaGetPhysicalDeviceProperties(m_allocator, &properties);
+    m_alignment = std::max({ VkDeviceSize{ 16 },
+                             properties->limits.minStorageBufferOffsetAlignment,
+                             properties->limits.minUniformBufferOffsetAlignment });
+}
+
+pvp::BufferPool::~BufferPool()
+{
+    // Every Buffer in the pool has to be destroyed by now, VMA asserts on blocks that still hold allocations
+    for (const std::unique_ptr<Block>& block : m_blocks)
+    {
+        vmaDestroyVirtualBlock(block->virtual_block);
+        block->buffer.destroy();
+    }
+}
+
+size_t pvp::BufferPool::get_block_count() const
+{
+    std::scoped_lock lock(m_mutex);
+    return m_blocks.size();
+}
+
+bool pvp::BufferPool::try_allocate(uint32_t block, VkDeviceSize size, Buffer& buffer)
+{
+    const VmaVirtualAllocationCreateInfo create_info{
+        .size = size,
+        .alignment = m_alignment,
+        .flags = VMA_VIRTUAL_ALLOCATION_CREATE_STRATEGY_MIN_TIME_BIT,
+    };
+    VmaVirtualAllocation allocation{};
+    VkDeviceSize         offset{};
+    if (vmaVirtualAllocate(m_blocks[block]->virtual_block, &create_info, &allocation, &offset) != VK_SUCCESS)
+    {
+        return false;
+    }
+
+    const Buffer& backing = m_blocks[block]->buffer;
+    buffer.m_pool = this;
+    buffer.m_pool_block = block;
+    buffer.m_virtual_allocation = allocation;
+    buffer.m_offset = offset;
+    buffer.m_buffer = backing.m_buffer;
+    buffer.m_allocator = backing.m_allocator;
+    buffer.m_allocation = backing.m_allocation;
+    buffer.m_allocation_info = backing.m_allocation_info;
+    buffer.m_allocation_info.offset += offset;
+    buffer.m_allocation_info.size = size;
+    if (backing.m_allocation_info.pMappedData != nullptr)
+    {
+        buffer.m_allocation_info.pMappedData = static_cast<std::byte*>(backing.m_allocation_info.pMappedData) + offset;
+    }
+    buffer.m_device_address = backing.m_device_address == 0 ? 0 : backing.m_device_address + offset;
+    m_current_block = block;
+    return true;
+}
+
+void pvp::BufferPool::allocate(VkDeviceSize size, Buffer& buffer)
+{
+    ZoneScoped;
+    std::scoped_lock lock(m_mutex);
+
+    // TLSF blocks allocate in constant time, and there are only ever a handful of blocks to try
+    if (!m_blocks.empty() && try_allocate(m_current_block, size, buffer))
+    {
+        return;
+    }
+    for (uint32_t block = 0; block < m_blocks.size(); ++block)
+    {
+        if (block != m_current_block && try_allocate(block, size, buffer))
+        {
+            return;
+        }
+    }
+
+    auto block = std::make_unique<Block>();
+    BufferBuilder()
+        .set_size(m_block_size)
+        .set_usage(m_usage)
+        .set_memory_usage(m_memory_usage)
+        .set_flags(m_flags)
+        .build(m_allocator, block->buffer);
+
+    const VmaVirtualBlockCreateInfo block_info{ .size = m_block_size };
+    if (vmaCreateVirtualBlock(&block_info, &block->virtual_block) != VK_SUCCESS)
+    {
+        block->buffer.destroy();
+        throw std::runtime_error("Can't create virtual block for buffer pool");
+    }
+    m_blocks.push_back(std::move(block));
+
+    if (!try_allocate(static_cast<uint32_t>(m_blocks.size() - 1), size, buffer))
+    {
+        throw std::runtime_error("Can't allocate from an empty buffer pool block");
+    }
+}
+
+void pvp::BufferPool::free(uint32_t block, VmaVirtualAllocation allocation)
+{
+    std::scoped_lock lock(m_mutex);
+    vmaVirtualFree(m_blocks[block]->virtual_block, allocation);
+}
@@ -0,0 +1,59 @@
+﻿#pragma once
+#include "Buffer.h"
+
+#include <globalconst.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace pvp
+{
+    // Large backing buffers handed out in aligned ranges through VmaVirtualBlocks, so a small Buffer costs no Vulkan
+    // objects of its own. Every range shares the usage and memory of the pool. Blocks are kept once created, so a
+    // Buffer only remembers the index of its block and creating or destroying one never searches.
+    class BufferPool final
+    {
+    public:
+        explicit BufferPool(const VmaAllocator& allocator, VkBufferUsageFlags usage, VmaMemoryUsage memory_usage, VmaAllocationCreateFlags flags, VkDeviceSize block_size);
+        ~BufferPool();
+        DISABLE_COPY(BufferPool);
+        DISABLE_MOVE(BufferPool);
+
+        // Larger buffers get one of their own, they wouldn't save anything and only fragment the blocks
+        [[nodiscard]] VkDeviceSize get_max_pooled_size() const
+        {
+            return m_block_size / 8;
+        }
+        [[nodiscard]] VkBufferUsageFlags get_usage() const
+        {
+            return m_usage;
+        }
+        [[nodiscard]] size_t get_block_count() const;
+
+    private:
+        friend class BufferBuilder;
+        friend class Buffer;
+
+        struct Block
+        {
+            Buffer          buffer;
+            VmaVirtualBlock virtual_block{ VK_NULL_HANDLE };
+        };
+
+        void allocate(VkDeviceSize size, Buffer& buffer);
+        void free(uint32_t block, VmaVirtualAllocation allocation);
+        // Only called with m_mutex held
+        [[nodiscard]] bool try_allocate(uint32_t block, VkDeviceSize size, Buffer& buffer);
+
+        VmaAllocator             m_allocator;
+        VkBufferUsageFlags       m_usage;
+        VmaMemoryUsage           m_memory_usage;
+        VmaAllocationCreateFlags m_flags;
+        VkDeviceSize             m_block_size;
+        VkDeviceSize             m_alignment;
+
+        mutable std::mutex                  m_mutex; // Scenes are built on a loader thread while the old one is destroyed
+        std::vector<std::unique_ptr<Block>> m_blocks;
+        uint32_t                            m_current_block{}; // Where the last allocation went, tried first
+    };
+} // namespace pvp
@@ -0,0 +1,113 @@
+﻿#include "StagingRing.h"
+
+#include <VMAAllocator/VmaAllocator.h>
+#include <tracy/Tracy.hpp>
+
+pvp::StagingRing::StagingRing(const Context& context, VkDeviceSize size)
+    : m_context{ context }
+    , m_size{ size }
+{
+    ZoneScoped;
+    BufferBuilder()
+        .set_size(size)
+        .set_usage(VK_BUFFER_USAGE_TRANSFER_SRC_BIT)
+        .set_flags(VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT)
+        .set_memory_usage(VMA_MEMORY_USAGE_AUTO_PREFER_HOST)
+        .build(m_context.allocator->get_allocator(), m_buffer);
+    m_memory = static_cast<std::byte*>(m_buffer.get_allocation_info().pMappedData);
+}
+
+pvp::StagingRing::~StagingRing()
+{
+    // The owner makes sure nothing still copies out of the ring
+    m_buffer.destroy();
+}
+
+std::optional<uint64_t> pvp::StagingRing::place(VkDeviceSize size, VkDeviceSize alignment) const
+{
+    if (size > m_size)
+    {
+        return std::nullopt;
+    }
+    uint64_t           start = (m_head + alignment - 1) / alignment * alignment;
+    const VkDeviceSize physical = start % m_size;
+    if (physical + size > m_size)
+    {
+        // Doesn't fit before the end, the rest of the lap is skipped
+        start += m_size - physical;
+    }
+    if (start + size - m_tail > m_size)
+    {
+        return std::nullopt;
+    }
+    return start;
+}
+
+std::optional<pvp::StagingRegion> pvp::StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+    const std::optional<uint64_t> start = place(size, alignment);
+    if (!start.has_value())
+    {
+        ++m_stats.stalls;
+        return std::nullopt;
+    }
+    m_head = start.value() + size;
+    ++m_stats.allocations;
+    m_stats.bytes += size;
+
+    const VkDeviceSize offset = start.value() % m_size;
+    return StagingRegion{ m_buffer.get_buffer(), offset, std::span(m_memory + offset, size) };
+}
+
+bool pvp::StagingRing::fits(VkDeviceSize size, VkDeviceSize alignment) const
+{
+    return place(size, alignment).has_value();
+}
+
+uint64_t pvp::StagingRing::mark()
+{
+    flush(m_marked_head, m_head);
+    m_marks.push_back(Mark{ m_next_mark, m_head });
+    m_marked_head = m_head;
+    return m_next_mark++;
+}
+
+void pvp::StagingRing::release(uint64_t mark)
+{
+    while (!m_marks.empty() && m_marks.front().id <= mark)
+    {
+        m_tail = m_marks.front().head;
+        m_marks.pop_front();
+    }
+}
+
+void pvp::StagingRing::release_all()
+{
+    release(mark());
+}
+
+// No-op on coherent memory, which is what the host preferred upload heaps usually are
+void pvp::StagingRing::flush(uint64_t begin, uint64_t end) const
+{
+    if (begin == end)
+    {
+        return;
+    }
+    const VmaAllocator allocator = m_context.allocator->get_allocator();
+    if (end - begin >= m_size)
+    {
+        vmaFlushAllocation(allocator, m_buffer.get_allocation(), 0, VK_WHOLE_SIZE);
+        return;
+    }
+    const VkDeviceSize first = begin % m_size;
+    const VkDeviceSize last = end % m_size;
+    if (first < last || last == 0)
+    {
+        vmaFlushAllocation(allocator, m_buffer.get_allocation(), first, (last == 0 ? m_size : last) - first);
+    }
+    else
+    {
+        vmaFlushAllocation(allocator, m_buffer.get_allocation(), first, m_size - first);
+        vmaFlushAllocation(allocator, m_buffer.get_allocation(), 0, last);
+    }
+}
@@ -0,0 +1,88 @@
+﻿#pragma once
+#include "Buffer.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <globalconst.h>
+#include <optional>
+#include <span>
+#include <Context/Context.h>
+
+namespace pvp
+{
+    // Part of the ring handed out for one copy. buffer and offset are the copy source, memory is where the data goes
+    struct StagingRegion
+    {
+        VkBuffer             buffer{ VK_NULL_HANDLE };
+        VkDeviceSize         offset{};
+        std::span<std::byte> memory;
+    };
+
+    // Read by the debug UI while a loader thread uploads, hence the atomics
+    struct StagingStats
+    {
+        std::atomic<uint64_t> bytes{}; // Handed out since creation
+        std::atomic<uint64_t> allocations{};
+        std::atomic<uint64_t> stalls{}; // Allocations that had to wait for older copies to be released
+    };
+
+    // One persistently mapped upload buffer, handed out front to back and wrapping around. Allocations are grouped by
+    // mark(), release() gives a group back once the GPU is done reading it, so no upload creates a buffer of its own.
+    class StagingRing final
+    {
+    public:
+        explicit StagingRing(const Context& context, VkDeviceSize size);
+        ~StagingRing();
+        DISABLE_COPY(StagingRing);
+        DISABLE_MOVE(StagingRing);
+
+        // Empty when size bytes don't fit in front of the oldest unreleased group, counted as a stall
+        [[nodiscard]] std::optional<StagingRegion> allocate(VkDeviceSize size, VkDeviceSize alignment = default_alignment);
+        [[nodiscard]] bool                         fits(VkDeviceSize size, VkDeviceSize alignment = default_alignment) const;
+        // Closes the group of everything allocated since the last mark and flushes it for the GPU
+        [[nodiscard]] uint64_t mark();
+        // Gives back every group up to and including mark
+        void release(uint64_t mark);
+        // Only once the GPU is done with every copy made from the ring
+        void release_all();
+
+        [[nodiscard]] VkDeviceSize get_size() const
+        {
+            return m_size;
+        }
+        [[nodiscard]] VkDeviceSize get_used() const
+        {
+            return m_head - m_tail;
+        }
+        [[nodiscard]] const StagingStats& get_stats() const
+        {
+            return m_stats;
+        }
+
+        constexpr static VkDeviceSize default_alignment{ 16 }; // Buffer to image copies of every format, BCn blocks included
+
+    private:
+        struct Mark
+        {
+            uint64_t id;
+            uint64_t head;
+        };
+
+        // Where an allocation would start, counted from creation so wrapping around never makes it go backwards
+        [[nodiscard]] std::optional<uint64_t> place(VkDeviceSize size, VkDeviceSize alignment) const;
+        void                                  flush(uint64_t begin, uint64_t end) const;
+
+        const Context&   m_context;
+        Buffer           m_buffer;
+        std::byte*       m_memory{};
+        VkDeviceSize     m_size;
+        uint64_t         m_head{};        // End of the newest allocation
+        uint64_t         m_tail{};        // Start of the oldest unreleased allocation
+        uint64_t         m_marked_head{}; // m_head at the last mark
+        uint64_t         m_next_mark{};
+        std::deque<Mark> m_marks;
+        StagingStats     m_stats;
+    };
+} // namespace pvp
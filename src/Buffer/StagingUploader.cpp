@@ -0,0 +1,106 @@
+﻿#include "StagingUploader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <tracy/Tracy.hpp>
+
+pvp::StagingUploader::StagingUploader(StagingRing& ring, CommandPool& pool, SubmitFunction submit)
+    : m_ring{ ring }
+    , m_pool{ pool }
+    , m_submit{ std::move(submit) }
+    , m_command_buffer{ pool.begin_buffer() }
+{
+}
+
+void pvp::StagingUploader::upload(std::span<const std::byte> data, const Buffer& destination, VkDeviceSize destination_offset)
+{
+    ZoneScoped;
+    while (!data.empty())
+    {
+        const VkDeviceSize  size = std::min<VkDeviceSize>(data.size_bytes(), get_max_chunk());
+        const StagingRegion region = acquire(size);
+        std::memcpy(region.memory.data(), data.data(), size);
+
+        const VkBufferCopy copy{ region.offset, destination.get_offset() + destination_offset, size };
+        vkCmdCopyBuffer(m_command_buffer, region.buffer, destination.get_buffer(), 1, &copy);
+        m_recorded = true;
+
+        data = data.subspan(size);
+        destination_offset += size;
+    }
+}
+
+void pvp::StagingUploader::upload_image(std::span<const std::byte> data, VkImage image, std::span<const ImageUploadLevel> levels, uint32_t block_size)
+{
+    ZoneScoped;
+    for (uint32_t level = 0; level < levels.size(); ++level)
+    {
+        const ImageUploadLevel& source = levels[level];
+        const uint32_t          block_rows = (source.height + block_size - 1) / block_size;
+        const VkDeviceSize      row_size = source.size / block_rows;
+        const uint32_t          rows_per_chunk = static_cast<uint32_t>(std::max<VkDeviceSize>(get_max_chunk() / row_size, 1));
+
+        for (uint32_t row = 0; row < block_rows; row += rows_per_chunk)
+        {
+            const uint32_t      row_count = std::min(rows_per_chunk, block_rows - row);
+            const VkDeviceSize  size = row_count * row_size;
+            const StagingRegion region = acquire(size);
+            std::memcpy(region.memory.data(), data.data() + source.offset + row * row_size, size);
+
+            const uint32_t          y = row * block_size;
+            const VkBufferImageCopy copy{
+                .bufferOffset = region.offset,
+                .imageSubresource = VkImageSubresourceLayers{ .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = level, .baseArrayLayer = 0, .layerCount = 1 },
+                .imageOffset = VkOffset3D{ 0, static_cast<int32_t>(y), 0 },
+                .imageExtent = VkExtent3D{ source.width, std::min(row_count * block_size, source.height - y), 1 },
+            };
+            vkCmdCopyBufferToImage(m_command_buffer, region.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+            m_recorded = true;
+        }
+    }
+}
+
+VkCommandBuffer pvp::StagingUploader::finish()
+{
+    (void)m_ring.mark();
+    return m_command_buffer;
+}
+
+// Waits for the oldest submit that still holds ring space until size fits
+pvp::StagingRegion pvp::StagingUploader::acquire(VkDeviceSize size)
+{
+    std::optional<StagingRegion> region = m_ring.allocate(size);
+    while (!region.has_value())
+    {
+        ZoneScopedN("Staging stall");
+        if (m_recorded)
+        {
+            submit_current();
+        }
+        if (m_in_flight.empty())
+        {
+            throw std::runtime_error("Staging ring is full without any uploads in flight");
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        m_pool.wait(m_in_flight.front().ticket);
+        m_stats.stall_micros += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+        m_ring.release(m_in_flight.front().mark);
+        m_in_flight.pop_front();
+        m_pool.recycle();
+        region = m_ring.allocate(size);
+    }
+    return region.value();
+}
+
+void pvp::StagingUploader::submit_current()
+{
+    const uint64_t     mark = m_ring.mark();
+    const SubmitTicket ticket = m_submit(m_command_buffer);
+    m_in_flight.push_back(InFlight{ ticket, mark });
+    m_command_buffer = m_pool.begin_buffer();
+    m_recorded = false;
+    ++m_stats.submits;
+}
@@ -0,0 +1,115 @@
+﻿#pragma once
+#include "StagingRing.h"
+
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <globalconst.h>
+#include <span>
+#include <vector>
+#include <CommandBuffer/CommandPool.h>
+
+namespace pvp
+{
+    // One mip level of an image upload, tightly packed at offset in the source data
+    struct ImageUploadLevel
+    {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        uint32_t     width;
+        uint32_t     height;
+    };
+
+    struct UploadStats
+    {
+        std::atomic<uint64_t> submits{};      // Command buffers handed out to make room in the ring
+        std::atomic<uint64_t> stall_micros{}; // Time spent waiting for the GPU to finish them
+    };
+
+    // Records copies out of a StagingRing into transfer command buffers. Uploads are split into chunks of at most a
+    // quarter of the ring, when it runs full the current buffer goes to submit and the oldest submit is waited on.
+    // submit only has to submit the buffer and return its ticket, so a thread that doesn't own the queue can upload.
+    class StagingUploader final
+    {
+    public:
+        using SubmitFunction = std::function<SubmitTicket(VkCommandBuffer)>;
+
+        explicit StagingUploader(StagingRing& ring, CommandPool& pool, SubmitFunction submit);
+        DISABLE_COPY(StagingUploader);
+        DISABLE_MOVE(StagingUploader);
+
+        // Where copies are recorded right now. Changes whenever the ring runs full, so get it again after uploading
+        [[nodiscard]] VkCommandBuffer get_command_buffer() const
+        {
+            return m_command_buffer;
+        }
+        [[nodiscard]] const UploadStats& get_stats() const
+        {
+            return m_stats;
+        }
+
+        void upload(std::span<const std::byte> data, const Buffer& destination, VkDeviceSize destination_offset = 0);
+        template<typename T>
+        void upload(std::span<const T> data, const Buffer& destination, VkDeviceSize destination_offset = 0)
+        {
+            upload(std::as_bytes(data), destination, destination_offset);
+        }
+        // fill writes the count elements straight into the ring when they fit in one chunk
+        template<typename T, typename FillFunction>
+        void fill(const Buffer& destination, size_t count, FillFunction&& fill);
+        // The image has to be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL. Levels too large for a chunk are copied in bands
+        // of texel block rows, block_size is the block height of the format
+        void upload_image(std::span<const std::byte> data, VkImage image, std::span<const ImageUploadLevel> levels, uint32_t block_size = 1);
+
+        // Hands the current command buffer over without submitting it. The ring keeps everything until the caller
+        // releases it once that buffer is done too
+        [[nodiscard]] VkCommandBuffer finish();
+
+    private:
+        struct InFlight
+        {
+            SubmitTicket ticket;
+            uint64_t     mark;
+        };
+
+        StagingRegion acquire(VkDeviceSize size);
+        void          submit_current();
+        VkDeviceSize  get_max_chunk() const
+        {
+            return m_ring.get_size() / 4;
+        }
+
+        StagingRing&         m_ring;
+        CommandPool&         m_pool;
+        SubmitFunction       m_submit;
+        VkCommandBuffer      m_command_buffer;
+        bool                 m_recorded{};
+        std::deque<InFlight> m_in_flight;
+        UploadStats          m_stats;
+    };
+
+    template<typename T, typename FillFunction>
+    void StagingUploader::fill(const Buffer& destination, size_t count, FillFunction&& fill)
+    {
+        const VkDeviceSize size = count * sizeof(T);
+        if (size == 0)
+        {
+            return;
+        }
+        if (size > get_max_chunk())
+        {
+            // Split it like any other upload, fill can't be told where a chunk ends
+            std::vector<T> data(count);
+            fill(std::span<T>(data));
+            upload(std::span<const T>(data), destination);
+            return;
+        }
+
+        const StagingRegion region = acquire(size);
+        fill(std::span<T>(reinterpret_cast<T*>(region.memory.data()), count));
+        const VkBufferCopy copy{ region.offset, destination.get_offset(), size };
+        vkCmdCopyBuffer(m_command_buffer, region.buffer, destination.get_buffer(), 1, &copy);
+        m_recorded = true;
+    }
+} // namespace pvp
@@ -0,0 +1,154 @@
+﻿#include <Scene/SceneBvh.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <string_view>
+#include <vector>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <spdlog/spdlog.h>
+
+// pvp-bvh-bench: builds a SceneBvh over random boxes and times building and querying it, no window or Vulkan needed.
+namespace
+{
+    struct Options
+    {
+        uint32_t item_count{ 100'000 };
+        uint32_t query_count{ 1'000 };
+        uint32_t nearest_count{ 64 };
+        uint32_t seed{ 1 };
+    };
+
+    void print_usage()
+    {
+        spdlog::info("usage: pvp-bvh-bench [options]\n"
+                     "  --items <count>    boxes in the tree (default 100000)\n"
+                     "  --queries <count>  frustum and nearest queries timed (default 1000)\n"
+                     "  --nearest <count>  items asked for per nearest query (default 64)\n"
+                     "  --seed <number>    random seed for the boxes and cameras (default 1)");
+    }
+
+    bool parse_number(std::string_view option, std::string_view value, uint32_t& out)
+    {
+        const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), out);
+        if (error != std::errc{} || end != value.data() + value.size())
+        {
+            spdlog::error("{} needs a number, got {}", option, value);
+            return false;
+        }
+        return true;
+    }
+
+    // Clusters of boxes of mixed sizes, closer to a real scene than a uniform spread
+    std::vector<pvp::Aabb> random_boxes(uint32_t count, std::mt19937& random)
+    {
+        std::uniform_real_distribution<float> cluster_position(-1000.0f, 1000.0f);
+        std::normal_distribution<float>       offset(0.0f, 40.0f);
+        std::lognormal_distribution<float>    extent(0.0f, 1.0f);
+
+        std::vector<glm::vec3> clusters(std::max(count / 500, 1u));
+        for (glm::vec3& cluster : clusters)
+        {
+            cluster = glm::vec3(cluster_position(random), cluster_position(random) * 0.1f, cluster_position(random));
+        }
+
+        std::vector<pvp::Aabb> boxes(count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const glm::vec3 center = clusters[i % clusters.size()] + glm::vec3(offset(random), offset(random), offset(random));
+            const glm::vec3 half = glm::vec3(extent(random), extent(random), extent(random));
+            boxes[i] = pvp::Aabb{ .min = center - half, .max = center + half };
+        }
+        return boxes;
+    }
+
+    template<typename Function>
+    double time_ms(Function&& function)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        function();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options{};
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view argument = argv[i];
+        const bool             has_value = i + 1 < argc;
+        bool                   parsed = false;
+        if (argument == "--items" && has_value)
+        {
+            parsed = parse_number(argument, argv[++i], options.item_count);
+        }
+        else if (argument == "--queries" && has_value)
+        {
+            parsed = parse_number(argument, argv[++i], options.query_count);
+        }
+        else if (argument == "--nearest" && has_value)
+        {
+            parsed = parse_number(argument, argv[++i], options.nearest_count);
+        }
+        else if (argument == "--seed" && has_value)
+        {
+            parsed = parse_number(argument, argv[++i], options.seed);
+        }
+        else
+        {
+            spdlog::error("Unknown option {}", argument);
+        }
+        if (!parsed)
+        {
+            print_usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::mt19937                 random(options.seed);
+    const std::vector<pvp::Aabb> boxes = random_boxes(options.item_count, random);
+
+    pvp::SceneBvh bvh;
+    const double  build_ms = time_ms([&] { bvh.build(boxes); });
+    spdlog::info("Built {} items into {} nodes in {:.3f} ms", bvh.size(), bvh.node_count(), build_ms);
+
+    // Cameras inside the spread of boxes looking along the ground plane
+    std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+    std::uniform_real_distribution<float> angle(0.0f, glm::two_pi<float>());
+    const glm::mat4                       projection = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 500.0f);
+    std::vector<pvp::Frustum>             frustums(options.query_count);
+    std::vector<glm::vec3>                points(options.query_count);
+    for (uint32_t i = 0; i < options.query_count; ++i)
+    {
+        points[i] = glm::vec3(position(random), 0.0f, position(random));
+        const float     yaw = angle(random);
+        const glm::mat4 view = glm::lookAt(points[i], points[i] + glm::vec3(std::cos(yaw), 0.0f, std::sin(yaw)), glm::vec3(0.0f, 1.0f, 0.0f));
+        frustums[i] = pvp::Frustum::from_matrix(projection * view);
+    }
+
+    std::vector<uint32_t> items;
+    size_t                visible{};
+    const double          frustum_ms = time_ms([&] {
+        for (const pvp::Frustum& frustum : frustums)
+        {
+            bvh.query_frustum(frustum, items);
+            visible += items.size();
+        }
+    });
+    const double nearest_ms = time_ms([&] {
+        for (const glm::vec3& point : points)
+        {
+            bvh.query_nearest(point, options.nearest_count, items);
+        }
+    });
+
+    const double query_count = std::max(options.query_count, 1u);
+    spdlog::info("Frustum queries: {:.4f} ms each, {:.0f} items visible on average", frustum_ms / query_count, static_cast<double>(visible) / query_count);
+    spdlog::info("Nearest {} queries: {:.4f} ms each", options.nearest_count, nearest_ms / query_count);
+    return EXIT_SUCCESS;
+}
@@ -22,10 +22,24 @@ namespace pvp
         {
             throw std::runtime_error("failed to create command pool!");
         }
+
+        VkSemaphoreTypeCreateInfo timeline_info{
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+            .initialValue = 0,
+        };
+        VkSemaphoreCreateInfo semaphore_info{ .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, .pNext = &timeline_info };
+        VK_CALL(vkCreateSemaphore(m_device, &semaphore_info, nullptr, &m_timeline));
     }
-    void CommandPool::destroy() const
+    void CommandPool::destroy()
     {
         ZoneScoped;
+        if (!m_pending.empty())
+        {
+            wait(SubmitTicket{ m_timeline, m_submitted_value });
+            recycle();
+        }
+        vkDestroySemaphore(m_device, m_timeline, nullptr);
         vkDestroyCommandPool(m_device, m_command_pool, nullptr);
     }
     VkCommandBuffer CommandPool::begin_buffer() const
@@ -47,9 +61,18 @@ namespace pvp
 
         return command_buffer;
     }
-    void CommandPool::end_buffer(VkCommandBuffer buffer, VkFence fence) const
+    void CommandPool::end_buffer(VkCommandBuffer buffer, VkFence fence)
     {
         ZoneScoped;
+        if (fence == VK_NULL_HANDLE)
+        {
+            // Only this submit is waited on, not everything else on the queue
+            const SubmitTicket ticket = submit(buffer);
+            wait(ticket);
+            recycle();
+            return;
+        }
+
         VK_CALL(vkEndCommandBuffer(buffer));
 
         VkCommandBufferSubmitInfo command_buffer_submit{
@@ -63,10 +86,87 @@ namespace pvp
         submit_info.commandBufferInfoCount = 1;
 
         VK_CALL(vkQueueSubmit2(m_queue.queue, 1, &submit_info, fence));
-        if (fence == VK_NULL_HANDLE)
+    }
+
+    SubmitTicket CommandPool::submit(VkCommandBuffer buffer, DestructorQueue&& release, std::span<const SubmitTicket> wait_for)
+    {
+        ZoneScoped;
+        VK_CALL(vkEndCommandBuffer(buffer));
+
+        std::vector<VkSemaphoreSubmitInfo> waits;
+        waits.reserve(wait_for.size());
+        for (const SubmitTicket& ticket : wait_for)
+        {
+            waits.push_back(VkSemaphoreSubmitInfo{
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+                .semaphore = ticket.semaphore,
+                .value = ticket.value,
+                .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+            });
+        }
+
+        const SubmitTicket    ticket{ m_timeline, ++m_submitted_value };
+        VkSemaphoreSubmitInfo signal{
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+            .semaphore = ticket.semaphore,
+            .value = ticket.value,
+            .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        };
+        VkCommandBufferSubmitInfo command_buffer_submit{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+            .commandBuffer = buffer
+        };
+
+        VkSubmitInfo2 submit_info{
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+            .waitSemaphoreInfoCount = static_cast<uint32_t>(waits.size()),
+            .pWaitSemaphoreInfos = waits.data(),
+            .commandBufferInfoCount = 1,
+            .pCommandBufferInfos = &command_buffer_submit,
+            .signalSemaphoreInfoCount = 1,
+            .pSignalSemaphoreInfos = &signal,
+        };
+        VK_CALL(vkQueueSubmit2(m_queue.queue, 1, &submit_info, VK_NULL_HANDLE));
+
+        m_pending.push_back(PendingSubmit{ ticket.value, buffer, std::move(release) });
+        return ticket;
+    }
+
+    bool CommandPool::is_done(const SubmitTicket& ticket) const
+    {
+        uint64_t value{};
+        VK_CALL(vkGetSemaphoreCounterValue(m_device, ticket.semaphore, &value));
+        return value >= ticket.value;
+    }
+
+    void CommandPool::wait(const SubmitTicket& ticket) const
+    {
+        ZoneScoped;
+        const VkSemaphoreWaitInfo wait_info{
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            .semaphoreCount = 1,
+            .pSemaphores = &ticket.semaphore,
+            .pValues = &ticket.value,
+        };
+        VK_CALL(vkWaitSemaphores(m_device, &wait_info, UINT64_MAX));
+    }
+
+    // Submits finish in order on one queue, so only the front of the list has to be checked
+    void CommandPool::recycle()
+    {
+        ZoneScoped;
+        if (m_pending.empty())
+        {
+            return;
+        }
+        uint64_t completed{};
+        VK_CALL(vkGetSemaphoreCounterValue(m_device, m_timeline, &completed));
+        while (!m_pending.empty() && m_pending.front().value <= completed)
         {
-            VK_CALL(vkQueueWaitIdle(m_queue.queue));
-            vkFreeCommandBuffers(m_device, m_command_pool, 1, &buffer);
+            PendingSubmit& done = m_pending.front();
+            vkFreeCommandBuffers(m_device, m_command_pool, 1, &done.buffer);
+            done.release.destroy_and_clear();
+            m_pending.pop_front();
         }
     }
 
@@ -1,25 +1,55 @@
 ﻿#pragma once
 #include "Context/QueueFamilies.h"
+#include <DestructorQueue.h>
+#include <cstdint>
+#include <deque>
+#include <span>
 #include <Context/Context.h>
 
 namespace pvp
 {
+    // A value on a pool's timeline semaphore, the submit that signals it is done once the semaphore gets there
+    struct SubmitTicket
+    {
+        VkSemaphore semaphore{ VK_NULL_HANDLE };
+        uint64_t    value{};
+    };
+
     class CommandPool final
     {
     public:
         explicit CommandPool() = default;
         explicit CommandPool(const Context& context, const Queue& queue, VkCommandPoolCreateFlags pool_flags);
-        void destroy() const;
+        // Waits for the submits still in flight first, their release queues run here
+        void destroy();
 
         [[nodiscard]] VkCommandBuffer begin_buffer() const;
-        void                          end_buffer(VkCommandBuffer buffer, VkFence fence = VK_NULL_HANDLE) const;
+        // Blocks until the buffer is done unless a fence is given
+        void end_buffer(VkCommandBuffer buffer, VkFence fence = VK_NULL_HANDLE);
+
+        // Ends and submits without waiting. The buffer is freed and release run by recycle() once the ticket is done,
+        // so staging memory the copies read from can be handed over with it
+        [[nodiscard]] SubmitTicket submit(VkCommandBuffer buffer, DestructorQueue&& release = {}, std::span<const SubmitTicket> wait_for = {});
+        [[nodiscard]] bool         is_done(const SubmitTicket& ticket) const;
+        void                       wait(const SubmitTicket& ticket) const;
+        void                       recycle();
 
         [[nodiscard]] std::vector<VkCommandBuffer> allocate_buffers(uint32_t count) const;
         [[nodiscard]] const Queue&                 get_queue() const;
 
     private:
-        VkDevice      m_device;
-        Queue         m_queue;
-        VkCommandPool m_command_pool{};
+        struct PendingSubmit
+        {
+            uint64_t        value;
+            VkCommandBuffer buffer;
+            DestructorQueue release;
+        };
+
+        VkDevice                  m_device;
+        Queue                     m_queue;
+        VkCommandPool             m_command_pool{};
+        VkSemaphore               m_timeline{ VK_NULL_HANDLE };
+        uint64_t                  m_submitted_value{};
+        std::deque<PendingSubmit> m_pending;
     };
 } // namespace pvp
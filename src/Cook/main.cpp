@@ -0,0 +1,241 @@
+﻿#include <Scene/ModelData.h>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <initializer_list>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <spdlog/spdlog.h>
+#include <tracy/Tracy.hpp>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#define RGBCX_IMPLEMENTATION
+#include <rgbcx.h>
+
+// pvp-cook: writes scene caches without starting the renderer. The cache files land in ./cache, the same relative
+// folder the app reads them from, so run it from the app's working directory.
+namespace
+{
+    bool is_scene_file(const std::filesystem::path& path)
+    {
+        const std::string extension = path.extension().string();
+        return extension == ".glb" || extension == ".obj" || extension == ".gltf" || extension == ".fbx";
+    }
+
+    void print_usage()
+    {
+        spdlog::info("usage: pvp-cook [options] <scene file or folder>...\n"
+                     "  --vertex-format full|packed\n"
+                     "  --cache-compression none|meshopt|meshopt-zstd\n"
+                     "  --texture-compression none|bcn\n"
+                     "  --no-mesh-optimization\n"
+                     "  --no-meshlet-lods\n"
+                     "  --meshlet-builder scan|flex|spatial\n"
+                     "  --meshlet-vertices <count>   must match what the app picks for the GPU (default 64)\n"
+                     "  --meshlet-triangles <count>  same (default 126)\n"
+                     "  --force         import even when the cache is up to date\n"
+                     "  --jobs <count>  scenes imported at the same time (default 2)");
+    }
+
+    // A misspelled value must not quietly cook caches with the default instead, so both report what they reject
+    template<typename T>
+    std::optional<T> parse_choice(std::string_view option, std::string_view value, std::initializer_list<std::pair<std::string_view, T>> choices)
+    {
+        for (const auto& [name, choice] : choices)
+        {
+            if (value == name)
+            {
+                return choice;
+            }
+        }
+        spdlog::error("Unknown value {} for {}", value, option);
+        return std::nullopt;
+    }
+
+    std::optional<uint32_t> parse_count(std::string_view option, std::string_view value)
+    {
+        uint32_t count{};
+        const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), count);
+        if (error != std::errc{} || end != value.data() + value.size() || count == 0)
+        {
+            spdlog::error("{} needs a positive number, got {}", option, value);
+            return std::nullopt;
+        }
+        return count;
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    ZoneScoped;
+    pvp::ImportSettings                settings{};
+    bool                               force{};
+    size_t                             job_count{ 2 };
+    std::vector<std::filesystem::path> scenes;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view argument = argv[i];
+        const bool             has_value = i + 1 < argc;
+        if (argument == "--vertex-format" && has_value)
+        {
+            const auto value = parse_choice<pvp::VertexFormat>(argument, argv[++i], { { "full", pvp::VertexFormat::full }, { "packed", pvp::VertexFormat::packed } });
+            if (!value)
+            {
+                print_usage();
+                return EXIT_FAILURE;
+            }
+            settings.vertex_format = *value;
+        }
+        else if (argument == "--cache-compression" && has_value)
+        {
+            const auto value = parse_choice<pvp::CacheCompression>(argument,
+                                                                   argv[++i],
+                                                                   { { "none", pvp::CacheCompression::none },
+                                                                     { "meshopt", pvp::CacheCompression::meshopt },
+                                                                     { "meshopt-zstd", pvp::CacheCompression::meshopt_zstd } });
+            if (!value)
+            {
+                print_usage();
+                return EXIT_FAILURE;
+            }
+            settings.cache_compression = *value;
+        }
+        else if (argument == "--texture-compression" && has_value)
+        {
+            const auto value = parse_choice<pvp::TextureCompression>(argument, argv[++i], { { "none", pvp::TextureCompression::none }, { "bcn", pvp::TextureCompression::bcn } });
+            if (!value)
+            {
+                print_usage();
+                return EXIT_FAILURE;
+            }
+            settings.texture_compression = *value;
+        }
+        else if (argument == "--no-mesh-optimization")
+        {
+            settings.mesh_optimization = pvp::MeshOptimization::none;
+        }
+        else if (argument == "--no-meshlet-lods")
+        {
+            settings.meshlet_lods = false;
+        }
+        else if (argument == "--meshlet-builder" && has_value)
+        {
+            const auto value = parse_choice<pvp::MeshletBuilder>(argument,
+                                                                 argv[++i],
+                                                                 { { "scan", pvp::MeshletBuilder::scan },
+                                                                   { "flex", pvp::MeshletBuilder::flex },
+                                                                   { "spatial", pvp::MeshletBuilder::spatial } });
+            if (!value)
+            {
+                print_usage();
+                return EXIT_FAILURE;
+            }
+            settings.meshlets.builder = *value;
+        }
+        else if (argument == "--meshlet-vertices" && has_value)
+        {
+            const std::optional<uint32_t> count = parse_count(argument, argv[++i]);
+            if (!count)
+            {
+                print_usage();
+                return EXIT_FAILURE;
+            }
+            settings.meshlets.max_vertices = *count;
+        }
+        else if (argument == "--meshlet-triangles" && has_value)
+        {
+            const std::optional<uint32_t> count = parse_count(argument, argv[++i]);
+            if (!count)
+            {
+                print_usage();
+                return EXIT_FAILURE;
+            }
+            settings.meshlets.max_triangles = *count;
+            settings.meshlets.min_triangles = std::min(settings.meshlets.min_triangles, settings.meshlets.max_triangles);
+        }
+        else if (argument == "--force")
+        {
+            force = true;
+        }
+        else if (argument == "--jobs" && has_value)
+        {
+            const std::optional<uint32_t> count = parse_count(argument, argv[++i]);
+            if (!count)
+            {
+                print_usage();
+                return EXIT_FAILURE;
+            }
+            job_count = *count;
+        }
+        else if (argument.starts_with("--"))
+        {
+            spdlog::error("Unknown option {}", argument);
+            print_usage();
+            return EXIT_FAILURE;
+        }
+        else if (std::filesystem::is_directory(argument))
+        {
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(argument))
+            {
+                if (entry.is_regular_file() && is_scene_file(entry.path()))
+                {
+                    scenes.push_back(entry.path());
+                }
+            }
+        }
+        else
+        {
+            scenes.emplace_back(argument);
+        }
+    }
+
+    if (scenes.empty())
+    {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+    // Every import already spreads its meshes and textures over all cores, a few scenes at once fills the gaps
+    // between those phases without holding every scene in memory
+    std::atomic<size_t> next_scene{};
+    std::atomic<size_t> failed_count{};
+    auto                worker = [&] {
+        for (size_t scene = next_scene++; scene < scenes.size(); scene = next_scene++)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            if (pvp::cook_scene(scenes[scene], settings, force))
+            {
+                const float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+                spdlog::info("Cooked {} in {:.2f}s", scenes[scene].string(), seconds);
+            }
+            else
+            {
+                spdlog::error("Failed to cook {}", scenes[scene].string());
+                ++failed_count;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < std::min(job_count, scenes.size()); ++i)
+    {
+        workers.emplace_back(worker);
+    }
+    for (std::thread& thread : workers)
+    {
+        thread.join();
+    }
+
+    return failed_count == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -30,6 +30,23 @@ void pvp::gizmos::draw_cone(const glm::vec3& tip, float height, const glm::vec3&
         lines.push_back(DebugVertex{ tip + (dir1 * angle * static_cast<float>(std::cos(rot_angle + ((1 / 36.0f) * std::numbers::pi * 2.0f))) + dir2 * angle * static_cast<float>(std::sin(rot_angle + ((1 / 36.0f) * std::numbers::pi * 2.0f))) + direction) * height, { 1, 1, 1, 1 } });
     }
 }
+void pvp::gizmos::draw_box(const glm::vec3& min, const glm::vec3& max, const glm::vec4& color)
+{
+    const auto corner = [&](int i) {
+        return glm::vec3{ i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z };
+    };
+    // Every pair of corners one bit apart is an edge
+    for (int i = 0; i < 8; ++i)
+    {
+        for (int bit = 1; bit < 8; bit <<= 1)
+        {
+            if ((i & bit) == 0)
+            {
+                draw_line(corner(i), corner(i | bit), color);
+            }
+        }
+    }
+}
 const std::vector<pvp::DebugVertex>& pvp::gizmos::get_lines()
 {
     return lines;
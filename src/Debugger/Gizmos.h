@@ -9,6 +9,7 @@ namespace pvp
     {
         void draw_line(const glm::vec3& p1, const glm::vec3& p2, const glm::vec4& color);
         void draw_cone(const glm::vec3& tip, float height, const glm::vec3& direction, float angle);
+        void draw_box(const glm::vec3& min, const glm::vec3& max, const glm::vec4& color);
 
         const std::vector<DebugVertex>& get_lines();
         void                            clear();
@@ -4,6 +4,7 @@
 #include "Gizmos.h"
 
 #include <VulkanExternalFunctions.h>
+#include <algorithm>
 #include <Context/Device.h>
 #include <DescriptorSets/CommonDescriptorLayouts.h>
 #include <DescriptorSets/DescriptorLayoutBuilder.h>
@@ -25,7 +26,7 @@ pvp::GizmosDrawer::GizmosDrawer(Context& context, const PvpScene& scene)
 
 void pvp::GizmosDrawer::draw(const FrameContext& cmd, uint32_t swapchain_image_index)
 {
-    const std::vector<DebugVertex>& lines = gizmos::get_lines();
+    const std::span<const DebugVertex> lines = std::span(gizmos::get_lines()).first(std::min<size_t>(gizmos::get_lines().size(), max_line_vertices));
     std::ranges::copy(lines, static_cast<DebugVertex*>(m_debug_lines_buffer.at(cmd.buffer_index).get_allocation_info().pMappedData));
 
     RenderInfoBuilderOut render_color_info;
@@ -40,11 +41,13 @@ void pvp::GizmosDrawer::draw(const FrameContext& cmd, uint32_t swapchain_image_i
     {
         vkCmdBindPipeline(cmd.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_spheres);
         vkCmdBindDescriptorSets(cmd.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layout_spheres, 0, 1, m_scene.get_scene_descriptor().get_descriptor_set(cmd), 0, nullptr);
+        vkCmdBindDescriptorSets(cmd.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layout_spheres, 1, 1, m_scene.get_indirect_descriptor_set().get_descriptor_set(cmd), 0, nullptr);
 
-        for (const Model& model : m_scene.get_models())
+        for (const Instance& instance : m_scene.get_instances())
         {
-            vkCmdBindDescriptorSets(cmd.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layout_spheres, 1, 1, model.meshlet_descriptor_set.get_descriptor_set(cmd), 0, nullptr);
-            vkCmdPushConstants(cmd.command_buffer, m_pipeline_layout_spheres, VK_SHADER_STAGE_MESH_BIT_EXT, 0, sizeof(MaterialTransform), &model.material);
+            const Model& model = m_scene.get_models()[instance.model_index];
+            vkCmdPushConstants(cmd.command_buffer, m_pipeline_layout_spheres, VK_SHADER_STAGE_MESH_BIT_EXT, 0, sizeof(MaterialTransform), &instance.material);
+            vkCmdPushConstants(cmd.command_buffer, m_pipeline_layout_spheres, VK_SHADER_STAGE_MESH_BIT_EXT, sizeof(MaterialTransform), sizeof(uint32_t), &instance.model_index);
             VulkanInstanceExtensions::vkCmdDrawMeshTasksEXT(cmd.command_buffer, model.meshlet_count, 1, 1);
         }
     }
@@ -65,7 +68,7 @@ void pvp::GizmosDrawer::build_buffers()
     {
         BufferBuilder{}
             .set_memory_usage(VMA_MEMORY_USAGE_AUTO)
-            .set_size(sizeof(DebugVertex) * 1000)
+            .set_size(sizeof(DebugVertex) * max_line_vertices)
             .set_flags(VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT)
             .set_usage(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT)
             .build(m_context.allocator->get_allocator(), m_debug_lines_buffer[i]);
@@ -77,8 +80,8 @@ void pvp::GizmosDrawer::build_pipelines()
 {
     PipelineLayoutBuilder()
         .add_descriptor_layout(m_context.descriptor_creator->get_layout().from_tag(DiscriptorTag::scene_globals).get())
-        .add_descriptor_layout(m_context.descriptor_creator->get_layout().from_tag(DiscriptorTag::meshlets).get())
-        .add_push_constant_range(VkPushConstantRange{ VK_SHADER_STAGE_MESH_BIT_EXT, 0, sizeof(MaterialTransform) })
+        .add_descriptor_layout(m_context.descriptor_creator->get_layout().from_tag(DiscriptorTag::big_buffers).get())
+        .add_push_constant_range(VkPushConstantRange{ VK_SHADER_STAGE_MESH_BIT_EXT, 0, sizeof(MaterialTransform) + sizeof(uint32_t) })
         .build(m_context.device->get_device(), m_pipeline_layout_spheres);
     m_destructor_queue.add_to_queue([&] {
         vkDestroyPipelineLayout(m_context.device->get_device(), m_pipeline_layout_spheres, nullptr);
@@ -49,5 +49,7 @@ namespace pvp
         // DescriptorSets   m_sphere_descriptor;
 
         DestructorQueue m_destructor_queue;
+
+        constexpr static uint32_t max_line_vertices{ 16384 }; // Lines past this are dropped
     };
 } // namespace pvp
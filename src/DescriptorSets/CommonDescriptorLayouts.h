@@ -10,7 +10,6 @@ namespace pvp
         bindless_textures,
         lights,
         gbuffers,
-        meshlets,
         big_buffers,
         pointers,
     };
@@ -82,7 +82,7 @@ namespace pvp
             {
                 VkDescriptorBufferInfo buffer_info{};
                 buffer_info.buffer = std::get<1>(buffer)->get_buffer(frame_index).get_buffer();
-                buffer_info.offset = 0;
+                buffer_info.offset = std::get<1>(buffer)->get_buffer(frame_index).get_offset();
                 buffer_info.range = std::get<1>(buffer)->get_buffer(frame_index).get_size();
 
                 VkWriteDescriptorSet write{};
@@ -170,7 +170,7 @@ namespace pvp
             {
                 VkDescriptorBufferInfo buffer_info{};
                 buffer_info.buffer = std::get<1>(buffer).get_buffer();
-                buffer_info.offset = 0;
+                buffer_info.offset = std::get<1>(buffer).get_offset();
                 buffer_info.range = std::get<1>(buffer).get_size();
 
                 VkWriteDescriptorSet write{};
@@ -1,5 +1,22 @@
 #include "DestructorQueue.h"
 
+DestructorQueue::DestructorQueue(DestructorQueue&& other) noexcept
+    : m_destruction_functions(std::move(other.m_destruction_functions))
+{
+    other.m_destruction_functions.clear();
+}
+
+DestructorQueue& DestructorQueue::operator=(DestructorQueue&& other) noexcept
+{
+    if (this != &other)
+    {
+        destroy_and_clear();
+        m_destruction_functions = std::move(other.m_destruction_functions);
+        other.m_destruction_functions.clear();
+    }
+    return *this;
+}
+
 void DestructorQueue::add_to_queue(std::function<void()>&& function)
 {
     m_destruction_functions.push_back(std::move(function));
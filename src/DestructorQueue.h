@@ -8,6 +8,13 @@
 class DestructorQueue final
 {
 public:
+    DestructorQueue() = default;
+    // Moving hands the functions over, copying would run them twice
+    DestructorQueue(DestructorQueue&& other) noexcept;
+    DestructorQueue& operator=(DestructorQueue&& other) noexcept;
+    DestructorQueue(const DestructorQueue&) = delete;
+    DestructorQueue& operator=(const DestructorQueue&) = delete;
+
     void add_to_queue(std::function<void()>&& function);
     void destroy_and_clear();
     ~DestructorQueue();
@@ -23,7 +23,7 @@ void pvp::GraphicsPipelineBuilder::build(const Device& device, VkPipeline& pipel
     bool mesh_shader = false;
 
     std::transform(std::execution::par_unseq, m_shader_stages.begin(), m_shader_stages.end(), pipeline_shader_stages.begin(), [&](auto& shader) {
-        std::get<2>(shader) = ShaderLoader::load_shader_from_file(device.get_device(), std::get<0>(shader));
+        std::get<2>(shader) = ShaderLoader::load_shader_from_file(device.get_device(), std::get<0>(shader), std::get<3>(shader));
 
         if (std::get<1>(shader) == VK_SHADER_STAGE_VERTEX_BIT)
         {
@@ -163,9 +163,9 @@ void pvp::GraphicsPipelineBuilder::build(const Device& device, VkPipeline& pipel
     }
 }
 
-pvp::GraphicsPipelineBuilder& pvp::GraphicsPipelineBuilder::add_shader(std::filesystem::path path, VkShaderStageFlagBits stage)
+pvp::GraphicsPipelineBuilder& pvp::GraphicsPipelineBuilder::add_shader(std::filesystem::path path, VkShaderStageFlagBits stage, std::span<const ShaderLoader::ShaderDefine> defines)
 {
-    m_shader_stages.push_back(std::tuple(path, stage, VK_NULL_HANDLE));
+    m_shader_stages.push_back(std::tuple(path, stage, VkShaderModule{ VK_NULL_HANDLE }, std::vector(defines.begin(), defines.end())));
     return *this;
 }
 
@@ -1,4 +1,6 @@
 ﻿#pragma once
+#include "ShaderLoader.h"
+
 #include <filesystem>
 #include <span>
 #include <Context/Device.h>
@@ -14,7 +16,7 @@ namespace pvp
     class GraphicsPipelineBuilder
     {
     public:
-        GraphicsPipelineBuilder& add_shader(std::filesystem::path path, VkShaderStageFlagBits stage);
+        GraphicsPipelineBuilder& add_shader(std::filesystem::path path, VkShaderStageFlagBits stage, std::span<const ShaderLoader::ShaderDefine> defines = {});
         GraphicsPipelineBuilder& set_input_binding_description(const range_of<VkVertexInputBindingDescription> auto& binding_description);
         GraphicsPipelineBuilder& set_input_attribute_description(const range_of<VkVertexInputAttributeDescription> auto& binding_description);
         GraphicsPipelineBuilder& set_topology(VkPrimitiveTopology topology);
@@ -28,17 +30,17 @@ namespace pvp
         void build(const Device& device, VkPipeline& pipeline);
 
     private:
-        std::vector<std::tuple<std::filesystem::path, VkShaderStageFlagBits, VkShaderModule>> m_shader_stages;
-        std::vector<VkVertexInputBindingDescription>                                          m_input_binding_descriptions;
-        std::vector<VkVertexInputAttributeDescription>                                        m_input_attribute_descriptions;
-        std::vector<VkFormat>                                                                 m_color_formats;
-        std::vector<VkPipelineColorBlendAttachmentState>                                      m_blends;
-        VkFormat                                                                              m_depth_format{ VK_FORMAT_D32_SFLOAT_S8_UINT };
-        VkPrimitiveTopology                                                                   m_topology{ VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST };
-        VkPipelineLayout                                                                      m_pipeline_layout{ nullptr };
-        VkCullModeFlags                                                                       m_cull_mode{ VK_CULL_MODE_BACK_BIT };
-        VkBool32                                                                              m_read{ VK_TRUE };
-        VkBool32                                                                              m_write{ VK_TRUE };
+        std::vector<std::tuple<std::filesystem::path, VkShaderStageFlagBits, VkShaderModule, std::vector<ShaderLoader::ShaderDefine>>> m_shader_stages;
+        std::vector<VkVertexInputBindingDescription>                                                                                   m_input_binding_descriptions;
+        std::vector<VkVertexInputAttributeDescription>                                                                                 m_input_attribute_descriptions;
+        std::vector<VkFormat>                                                                                                          m_color_formats;
+        std::vector<VkPipelineColorBlendAttachmentState>                                                                               m_blends;
+        VkFormat                                                                                                                       m_depth_format{ VK_FORMAT_D32_SFLOAT_S8_UINT };
+        VkPrimitiveTopology                                                                                                            m_topology{ VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST };
+        VkPipelineLayout                                                                                                               m_pipeline_layout{ nullptr };
+        VkCullModeFlags                                                                                                                m_cull_mode{ VK_CULL_MODE_BACK_BIT };
+        VkBool32                                                                                                                       m_read{ VK_TRUE };
+        VkBool32                                                                                                                       m_write{ VK_TRUE };
     };
 
     GraphicsPipelineBuilder& GraphicsPipelineBuilder::set_input_binding_description(const range_of<VkVertexInputBindingDescription> auto& binding_description)
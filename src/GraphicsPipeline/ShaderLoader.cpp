@@ -188,12 +188,22 @@ std::vector<char> ShaderLoader::load_file(const std::filesystem::path& path)
     return buffer;
 }
 
-std::string get_shader_string(const std::filesystem::path& path)
+std::string get_variant_name(const std::filesystem::path& path, std::span<const ShaderLoader::ShaderDefine> defines)
 {
-    return std::format("{}, {:%Y%m%d%H%M}, {}.spirv", path.filename().string(), std::filesystem::last_write_time(path), std::filesystem::file_size(path));
+    std::string name = path.filename().string();
+    for (const ShaderLoader::ShaderDefine& define : defines)
+    {
+        name += std::format("_{}{}", define.name, define.value);
+    }
+    return name;
 }
 
-VkShaderModule ShaderLoader::load_shader_from_file(const VkDevice& device, const std::filesystem::path& path)
+std::string get_shader_string(const std::filesystem::path& path, std::span<const ShaderLoader::ShaderDefine> defines)
+{
+    return std::format("{}, {:%Y%m%d%H%M}, {}.spirv", get_variant_name(path, defines), std::filesystem::last_write_time(path), std::filesystem::file_size(path));
+}
+
+VkShaderModule ShaderLoader::load_shader_from_file(const VkDevice& device, const std::filesystem::path& path, std::span<const ShaderDefine> defines)
 {
     ZoneScoped;
     if (!std::filesystem::is_directory("cache"))
@@ -201,7 +211,7 @@ VkShaderModule ShaderLoader::load_shader_from_file(const VkDevice& device, const
         std::filesystem::create_directory("cache");
     }
 
-    const std::string           shader_cached_name = get_shader_string(path);
+    const std::string           shader_cached_name = get_shader_string(path, defines);
     const std::filesystem::path filepath = std::filesystem::path("cache") / shader_cached_name;
 
     VkShaderModuleCreateInfo create_info{};
@@ -220,9 +230,11 @@ VkShaderModule ShaderLoader::load_shader_from_file(const VkDevice& device, const
     }
     else
     {
+        // Only outdated copies of this variant, other variants of the same file stay cached
+        const std::string variant_prefix = get_variant_name(path, defines) + ",";
         for (const std::filesystem::directory_entry& file : std::filesystem::recursive_directory_iterator(filepath.parent_path()))
         {
-            if (file.path().filename().string().contains(path.filename().string()))
+            if (file.path().filename().string().starts_with(variant_prefix))
             {
                 std::filesystem::remove(file.path());
             }
@@ -234,6 +246,10 @@ VkShaderModule ShaderLoader::load_shader_from_file(const VkDevice& device, const
         compile_command << "-V ";
         compile_command << "--target-env vulkan1.4 ";
         compile_command << "-r ";
+        for (const ShaderDefine& define : defines)
+        {
+            compile_command << "-D" << define.name << "=" << define.value << " ";
+        }
         compile_command << path << " ";
         compile_command << "-o " << filepath << " ";
         compile_command << "-gVS";
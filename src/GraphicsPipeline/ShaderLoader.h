@@ -1,12 +1,21 @@
 ﻿#pragma once
 #include <filesystem>
+#include <span>
 #include <stdexcept>
+#include <string>
 #include <vector>
 #include <vulkan/vulkan.h>
 
 namespace ShaderLoader
 {
+    // Passed to the compiler as -Dname=value. Every set of defines is compiled and cached as its own variant.
+    struct ShaderDefine
+    {
+        std::string name;
+        std::string value;
+    };
+
     void              init();
     std::vector<char> load_file(const std::filesystem::path& path);
-    VkShaderModule    load_shader_from_file(const VkDevice& device, const std::filesystem::path& path);
+    VkShaderModule    load_shader_from_file(const VkDevice& device, const std::filesystem::path& path, std::span<const ShaderDefine> defines = {});
 }; // namespace ShaderLoader
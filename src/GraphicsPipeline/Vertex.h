@@ -1,11 +1,19 @@
 ﻿#pragma once
 #include <array>
+#include <cstdint>
+#include <vector>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <vulkan/vulkan.h>
 
 namespace pvp
 {
+    enum class VertexFormat : uint32_t
+    {
+        full = 0,
+        packed = 1
+    };
+
     struct Vertex
     {
         alignas(16) glm::vec3 pos;
@@ -53,4 +61,56 @@ namespace pvp
                 } });
         }
     };
+
+    // 20 byte vertex chosen at import time. The position is unorm16 relative to the mesh bounds
+    // (MaterialTransform::position_offset/position_scale), normal and tangent are octahedral snorm16 and the uv is half float.
+    // Decoded by decode_vertex in shared_structs.glsl.
+    struct PackedVertex
+    {
+        std::array<uint16_t, 4> pos; // w is unused
+        std::array<int16_t, 2>  normal;
+        std::array<int16_t, 2>  tangent;
+        std::array<uint16_t, 2> uv;
+
+        static constexpr auto get_attribute_descriptions()
+        {
+            return std::vector<VkVertexInputAttributeDescription>(
+                { {
+                      .location = 0,
+                      .binding = 0,
+                      .format = VK_FORMAT_R16G16B16A16_UNORM,
+                      .offset = offsetof(PackedVertex, pos),
+                  },
+                  {
+                      .location = 1,
+                      .binding = 0,
+                      .format = VK_FORMAT_R16G16_SFLOAT,
+                      .offset = offsetof(PackedVertex, uv),
+                  },
+                  {
+                      .location = 2,
+                      .binding = 0,
+                      .format = VK_FORMAT_R16G16_SNORM,
+                      .offset = offsetof(PackedVertex, normal),
+                  },
+                  {
+                      .location = 3,
+                      .binding = 0,
+                      .format = VK_FORMAT_R16G16_SNORM,
+                      .offset = offsetof(PackedVertex, tangent),
+                  }
+
+                });
+        };
+        static constexpr auto get_binding_description()
+        {
+            return std::vector<VkVertexInputBindingDescription>(
+                { {
+                    .binding = 0,
+                    .stride = sizeof(PackedVertex),
+                    .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+                } });
+        }
+    };
+    static_assert(sizeof(PackedVertex) == 20);
 } // namespace pvp
@@ -48,6 +48,19 @@ pvp::ImageBuilder& pvp::ImageBuilder::set_use_mipmap(bool enabled)
     return *this;
 }
 
+pvp::ImageBuilder& pvp::ImageBuilder::set_mip_levels(uint32_t levels)
+{
+    m_use_minimaps = levels > 1;
+    m_mip_levels = levels;
+    return *this;
+}
+
+pvp::ImageBuilder& pvp::ImageBuilder::set_swizzle(const VkComponentMapping& swizzle)
+{
+    m_swizzle = swizzle;
+    return *this;
+}
+
 pvp::ImageBuilder& pvp::ImageBuilder::set_aspect_flags(VkImageAspectFlags aspect_flags)
 {
     m_aspect_flags = aspect_flags;
@@ -90,6 +103,7 @@ void pvp::ImageBuilder::build(const Context& context, pvp::Image& image) const
     view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     view_info.image = VK_NULL_HANDLE;
     view_info.format = m_format;
+    view_info.components = m_swizzle;
     view_info.subresourceRange.aspectMask = m_aspect_flags;
     view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
     view_info.subresourceRange.baseMipLevel = 0;
@@ -108,6 +122,10 @@ void pvp::ImageBuilder::build(const Context& context, pvp::StaticImage& image) c
     VkExtent3D image_size = VkExtent3D(m_size.width, m_size.height, 1);
 
     image.m_mip_map_levels = m_use_minimaps ? static_cast<uint32_t>(floor(std::log2(std::max(m_size.width, m_size.height))) + 1) : 1;
+    if (m_mip_levels != 0)
+    {
+        image.m_mip_map_levels = m_mip_levels;
+    }
 
     VkImageCreateInfo create_info{};
     create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -140,6 +158,7 @@ void pvp::ImageBuilder::build(const Context& context, pvp::StaticImage& image) c
     view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     view_info.image = image.m_image;
     view_info.format = m_format;
+    view_info.components = m_swizzle;
     view_info.subresourceRange.aspectMask = m_aspect_flags;
     view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
     view_info.subresourceRange.baseMipLevel = 0;
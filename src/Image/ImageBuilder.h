@@ -22,6 +22,8 @@ namespace pvp
         ImageBuilder& set_aspect_flags(VkImageAspectFlags aspect_flags);
         ImageBuilder& set_memory_usage(VmaMemoryUsage memory_usage);
         ImageBuilder& set_use_mipmap(bool enabled);
+        ImageBuilder& set_mip_levels(uint32_t levels);
+        ImageBuilder& set_swizzle(const VkComponentMapping& swizzle);
 
         void build(const Context& context, Image& image) const;
         void build(const Context& context, StaticImage& image) const;
@@ -31,9 +33,11 @@ namespace pvp
         VkExtent2D         m_size{};
         bool               m_use_screen_size_auto_update{};
         bool               m_use_minimaps{};
+        uint32_t           m_mip_levels{}; // 0 picks the full chain when mipmaps are enabled
         VkFormat           m_format{ VK_FORMAT_R8G8B8_SRGB };
         VkImageUsageFlags  m_usage{ VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT };
         VkImageAspectFlags m_aspect_flags{ VK_IMAGE_ASPECT_COLOR_BIT };
         VmaMemoryUsage     m_memory_usage{ VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE };
+        VkComponentMapping m_swizzle{};
     };
 } // namespace pvp
\ No newline at end of file
@@ -60,4 +60,14 @@ void pvp::StaticImage::copy_from_buffer(VkCommandBuffer cmd, const Buffer& buffe
                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                            1,
                            &region);
+}
+
+void pvp::StaticImage::copy_from_buffer(VkCommandBuffer cmd, const Buffer& buffer, std::span<const VkBufferImageCopy> regions) const
+{
+    vkCmdCopyBufferToImage(cmd,
+                           buffer.get_buffer(),
+                           m_image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           static_cast<uint32_t>(regions.size()),
+                           regions.data());
 }
\ No newline at end of file
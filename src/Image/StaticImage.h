@@ -1,6 +1,7 @@
 ﻿#pragma once
 #include <array>
 #include <globalconst.h>
+#include <span>
 #include <string>
 #include <Buffer/Buffer.h>
 #include <VMAAllocator/VmaAllocator.h>
@@ -36,6 +37,7 @@ namespace pvp
         void transition_layout(VkCommandBuffer command_buffer, VkImageLayout new_layout, VkPipelineStageFlags2 src_stage_mask, VkPipelineStageFlags2 dst_stage_mask, VkAccessFlags2 src_access_mask, VkAccessFlags2 dst_access_mask);
         void transition_layout_range(VkCommandBuffer command_buffer, VkImageLayout old_layout, VkImageLayout new_layout, VkPipelineStageFlags2 src_stage_mask, VkPipelineStageFlags2 dst_stage_mask, VkAccessFlags2 src_access_mask, VkAccessFlags2 dst_access_mask, VkImageSubresourceRange range) const;
         void copy_from_buffer(VkCommandBuffer cmd, const Buffer& buffer) const;
+        void copy_from_buffer(VkCommandBuffer cmd, const Buffer& buffer, std::span<const VkBufferImageCopy> regions) const;
 
     private:
         friend class ImageBuilder;
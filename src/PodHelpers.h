@@ -1,5 +1,8 @@
 #pragma once
+#include <algorithm>
+#include <cstdint>
 #include <fstream>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -32,6 +35,26 @@ void inline write_string(std::ofstream& out, const std::string& str)
     }
 }
 
+// Pads the stream up to alignment and writes the data there. Returns the offset the data starts at.
+template<typename T>
+uint64_t write_aligned(std::ofstream& out, std::span<T> data, uint64_t alignment)
+{
+    constexpr char zeros[256]{};
+    const uint64_t position = static_cast<uint64_t>(out.tellp());
+    const uint64_t offset = (position + alignment - 1) / alignment * alignment;
+    for (uint64_t padding = offset - position; padding > 0;)
+    {
+        const uint64_t chunk = std::min<uint64_t>(padding, sizeof(zeros));
+        out.write(zeros, static_cast<std::streamsize>(chunk));
+        padding -= chunk;
+    }
+    if (!data.empty())
+    {
+        out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size_bytes()));
+    }
+    return offset;
+}
+
 // READ
 template<typename T>
 void read_pod(std::ifstream& in, T& val)
@@ -52,15 +52,22 @@ namespace pvp
                 ZoneNamedN(bind_texture, "Bind Scene+Texture", true);
                 vkCmdBindDescriptorSets(cmd.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layout, 0, 1, m_scene.get_scene_descriptor().get_descriptor_set(cmd), 0, nullptr);
                 vkCmdBindDescriptorSets(cmd.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layout, 1, 1, m_scene.get_textures_descriptor().get_descriptor_set(cmd), 0, nullptr);
-                vkCmdBindPipeline(cmd.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
-                for (const Model& model : m_scene.get_models())
+                vkCmdBindPipeline(cmd.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_scene.get_vertex_format() == VertexFormat::packed ? m_pipeline_packed : m_pipeline);
+                const std::vector<Instance>& instances = m_scene.get_instances();
+                for (const uint32_t i : m_scene.get_visible_instances())
                 {
                     ZoneScopedN("Draw");
-                    VkDeviceSize offset{ 0 };
-                    vkCmdBindVertexBuffers(cmd.command_buffer, 0, 1, &model.vertex_data.get_buffer(), &offset);
-                    vkCmdBindIndexBuffer(cmd.command_buffer, model.index_data.get_buffer(), 0, VK_INDEX_TYPE_UINT32);
-                    vkCmdPushConstants(cmd.command_buffer, m_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(MaterialTransform), &model.material.transform);
-                    vkCmdDrawIndexed(cmd.command_buffer, model.index_count, 1, 0, 0, 0);
+                    const Instance& instance = instances[i];
+                    const Model&    model = m_scene.get_models()[instance.model_index];
+                    if (!model.resident)
+                    {
+                        continue;
+                    }
+                    const IndexLod& lod = model.index_lods[m_scene.get_instance_lods()[i]];
+                    vkCmdBindVertexBuffers(cmd.command_buffer, 0, 1, &model.vertex_buffer, &model.vertex_offset);
+                    vkCmdBindIndexBuffer(cmd.command_buffer, model.index_buffer, model.index_offset, VK_INDEX_TYPE_UINT32);
+                    vkCmdPushConstants(cmd.command_buffer, m_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(MaterialTransform), &instance.material.transform);
+                    vkCmdDrawIndexed(cmd.command_buffer, lod.index_count, 1, lod.index_offset, 0, 0);
                 }
             }
             break;
@@ -75,7 +82,7 @@ namespace pvp
                 VkDeviceAddress matrix_buffer_address = m_scene.get_matrix_buffer_address();
                 vkCmdPushConstants(cmd.command_buffer, m_pipeline_meshshader_layout, VK_SHADER_STAGE_MESH_BIT_EXT | VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(VkDeviceAddress), &matrix_buffer_address);
 
-                VulkanInstanceExtensions::vkCmdDrawMeshTasksIndirectEXT(cmd.command_buffer, m_scene.get_indirect_draw_calls().get_buffer(), 0, m_scene.get_models().size(), sizeof(DrawCommandIndirect));
+                VulkanInstanceExtensions::vkCmdDrawMeshTasksIndirectEXT(cmd.command_buffer, m_scene.get_indirect_draw_calls().get_buffer(), m_scene.get_indirect_draw_calls().get_offset(), m_scene.get_instances().size(), sizeof(DrawCommandIndirect));
                 vkCmdEndQuery(cmd.command_buffer, m_context.query_pool, 0);
             }
             break;
@@ -117,6 +124,18 @@ namespace pvp
             vkDestroyPipeline(m_context.device->get_device(), m_pipeline, nullptr);
         });
 
+        GraphicsPipelineBuilder()
+            .add_shader("shaders/depthpass_packed.vert", VK_SHADER_STAGE_VERTEX_BIT)
+            .set_depth_format(m_depth_image.get_format())
+            .set_pipeline_layout(m_pipeline_layout)
+            .set_input_attribute_description(PackedVertex::get_attribute_descriptions())
+            .set_input_binding_description(PackedVertex::get_binding_description())
+            .set_depth_access(VK_TRUE, VK_TRUE)
+            .build(*m_context.device, m_pipeline_packed);
+        m_destructor_queue.add_to_queue([&] {
+            vkDestroyPipeline(m_context.device->get_device(), m_pipeline_packed, nullptr);
+        });
+
         PipelineLayoutBuilder()
             .add_descriptor_layout(m_context.descriptor_creator->get_layout().from_tag(DiscriptorTag::scene_globals).get())
             .add_descriptor_layout(m_context.descriptor_creator->get_layout().from_tag(DiscriptorTag::pointers).get())
@@ -129,7 +148,7 @@ namespace pvp
 
         GraphicsPipelineBuilder()
             .add_shader("shaders/triangle_simple_indirect_ptr.task", VK_SHADER_STAGE_TASK_BIT_EXT)
-            .add_shader("shaders/depthpass_ptr.mesh", VK_SHADER_STAGE_MESH_BIT_EXT)
+            .add_shader("shaders/depthpass_ptr.mesh", VK_SHADER_STAGE_MESH_BIT_EXT, m_scene.get_meshlet_defines())
             // .add_shader("shaders/depthpass_ptr.frag", VK_SHADER_STAGE_FRAGMENT_BIT)
             .set_depth_format(m_depth_image.get_format())
             .set_pipeline_layout(m_pipeline_meshshader_layout)
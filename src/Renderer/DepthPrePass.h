@@ -32,6 +32,7 @@ namespace pvp
 
         VkPipelineLayout m_pipeline_layout{};
         VkPipeline       m_pipeline{};
+        VkPipeline       m_pipeline_packed{};
 
         VkPipelineLayout m_pipeline_meshshader_layout{};
         VkPipeline       m_pipeline_meshshader{};
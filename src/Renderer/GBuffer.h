@@ -42,6 +42,7 @@ namespace pvp
 
         VkPipelineLayout m_pipeline_layout{};
         VkPipeline       m_albedo_pipeline{};
+        VkPipeline       m_albedo_pipeline_packed{};
 
         VkPipelineLayout m_meshlets_pipeline_layout{};
         VkPipeline       m_meshlets_albedo_pipeline{};
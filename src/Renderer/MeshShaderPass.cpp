@@ -68,12 +68,15 @@ void pvp::MeshShaderPass::draw(const FrameContext& cmd, uint32_t swapchain_image
         case RenderModeMeshLets::cpu: {
             vkCmdBindPipeline(cmd.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
             vkCmdBindDescriptorSets(cmd.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layout, 0, 1, m_scene.get_scene_descriptor().get_descriptor_set(cmd), 0, nullptr);
+            vkCmdBindDescriptorSets(cmd.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layout, 1, 1, m_scene.get_indirect_descriptor_set().get_descriptor_set(cmd), 0, nullptr);
 
-            for (const Model& model : m_scene.get_models())
+            for (const Instance& instance : m_scene.get_instances())
             {
                 ZoneScopedN("Draw");
-                vkCmdPushConstants(cmd.command_buffer, m_pipeline_layout, VK_SHADER_STAGE_MESH_BIT_EXT | VK_SHADER_STAGE_TASK_BIT_EXT, 0, sizeof(MaterialTransform), &model.material);
-                vkCmdBindDescriptorSets(cmd.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layout, 1, 1, model.meshlet_descriptor_set.get_descriptor_set(cmd), 0, nullptr);
+                const Model& model = m_scene.get_models()[instance.model_index];
+                vkCmdPushConstants(cmd.command_buffer, m_pipeline_layout, VK_SHADER_STAGE_MESH_BIT_EXT | VK_SHADER_STAGE_TASK_BIT_EXT, 0, sizeof(MaterialTransform), &instance.material);
+                // Finds the model's ranges of the scene wide buffers
+                vkCmdPushConstants(cmd.command_buffer, m_pipeline_layout, VK_SHADER_STAGE_MESH_BIT_EXT | VK_SHADER_STAGE_TASK_BIT_EXT, sizeof(MaterialTransform), sizeof(uint32_t), &instance.model_index);
                 uint32_t thread_group_count_x = model.meshlet_count / mesh_let_count + 1;
                 VulkanInstanceExtensions::vkCmdDrawMeshTasksEXT(cmd.command_buffer, thread_group_count_x, 1, 1);
             }
@@ -84,7 +87,7 @@ void pvp::MeshShaderPass::draw(const FrameContext& cmd, uint32_t swapchain_image
             vkCmdBindDescriptorSets(cmd.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layout_indirect, 0, 1, m_scene.get_scene_descriptor().get_descriptor_set(cmd), 0, nullptr);
             vkCmdBindDescriptorSets(cmd.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layout_indirect, 1, 1, m_scene.get_indirect_descriptor_set().get_descriptor_set(cmd), 0, nullptr);
 
-            VulkanInstanceExtensions::vkCmdDrawMeshTasksIndirectEXT(cmd.command_buffer, m_scene.get_indirect_draw_calls().get_buffer(), 0, m_scene.get_models().size(), sizeof(DrawCommandIndirect));
+            VulkanInstanceExtensions::vkCmdDrawMeshTasksIndirectEXT(cmd.command_buffer, m_scene.get_indirect_draw_calls().get_buffer(), m_scene.get_indirect_draw_calls().get_offset(), m_scene.get_instances().size(), sizeof(DrawCommandIndirect));
         }
         break;
         case RenderModeMeshLets::gpu_indirect_pointers: {
@@ -95,7 +98,7 @@ void pvp::MeshShaderPass::draw(const FrameContext& cmd, uint32_t swapchain_image
             VkDeviceAddress matrix_buffer_address = m_scene.get_matrix_buffer_address();
             vkCmdPushConstants(cmd.command_buffer, m_pipeline_layout_indirect_ptr, VK_SHADER_STAGE_MESH_BIT_EXT | VK_SHADER_STAGE_TASK_BIT_EXT, 0, sizeof(VkDeviceAddress), &matrix_buffer_address);
 
-            VulkanInstanceExtensions::vkCmdDrawMeshTasksIndirectEXT(cmd.command_buffer, m_scene.get_indirect_draw_calls().get_buffer(), 0, m_scene.get_models().size(), sizeof(DrawCommandIndirect));
+            VulkanInstanceExtensions::vkCmdDrawMeshTasksIndirectEXT(cmd.command_buffer, m_scene.get_indirect_draw_calls().get_buffer(), m_scene.get_indirect_draw_calls().get_offset(), m_scene.get_instances().size(), sizeof(DrawCommandIndirect));
         }
         break;
     }
@@ -108,7 +111,7 @@ void pvp::MeshShaderPass::build_pipelines()
     ZoneScoped;
     PipelineLayoutBuilder()
         .add_descriptor_layout(m_context.descriptor_creator->get_layout().from_tag(DiscriptorTag::scene_globals).get())
-        .add_descriptor_layout(m_context.descriptor_creator->get_layout().from_tag(DiscriptorTag::meshlets).get())
+        .add_descriptor_layout(m_context.descriptor_creator->get_layout().from_tag(DiscriptorTag::big_buffers).get())
         .add_push_constant_range(VkPushConstantRange{ VK_SHADER_STAGE_MESH_BIT_EXT | VK_SHADER_STAGE_TASK_BIT_EXT, 0, sizeof(MaterialTransform) + sizeof(uint32_t) })
         .build(m_context.device->get_device(), m_pipeline_layout);
     m_destructor_queue.add_to_queue([&] {
@@ -117,7 +120,7 @@ void pvp::MeshShaderPass::build_pipelines()
 
     GraphicsPipelineBuilder()
         .add_shader("shaders/triangle_simple.task", VK_SHADER_STAGE_TASK_BIT_EXT)
-        .add_shader("shaders/triangle_simple.mesh", VK_SHADER_STAGE_MESH_BIT_EXT)
+        .add_shader("shaders/triangle_simple.mesh", VK_SHADER_STAGE_MESH_BIT_EXT, m_scene.get_meshlet_defines())
         .add_shader("shaders/triangle_simple.frag", VK_SHADER_STAGE_FRAGMENT_BIT)
         .set_depth_format(m_depth_image.get_format())
         .set_depth_access(VK_TRUE, VK_TRUE)
@@ -138,7 +141,7 @@ void pvp::MeshShaderPass::build_pipelines()
 
     GraphicsPipelineBuilder()
         .add_shader("shaders/triangle_simple_indirect.task", VK_SHADER_STAGE_TASK_BIT_EXT)
-        .add_shader("shaders/triangle_simple_indirect.mesh", VK_SHADER_STAGE_MESH_BIT_EXT)
+        .add_shader("shaders/triangle_simple_indirect.mesh", VK_SHADER_STAGE_MESH_BIT_EXT, m_scene.get_meshlet_defines())
         .add_shader("shaders/triangle_simple.frag", VK_SHADER_STAGE_FRAGMENT_BIT)
         .set_depth_format(m_depth_image.get_format())
         .set_depth_access(VK_TRUE, VK_TRUE)
@@ -160,7 +163,7 @@ void pvp::MeshShaderPass::build_pipelines()
 
     GraphicsPipelineBuilder()
         .add_shader("shaders/triangle_simple_indirect_ptr.task", VK_SHADER_STAGE_TASK_BIT_EXT)
-        .add_shader("shaders/triangle_simple_indirect_ptr.mesh", VK_SHADER_STAGE_MESH_BIT_EXT)
+        .add_shader("shaders/triangle_simple_indirect_ptr.mesh", VK_SHADER_STAGE_MESH_BIT_EXT, m_scene.get_meshlet_defines())
         .add_shader("shaders/triangle_simple.frag", VK_SHADER_STAGE_FRAGMENT_BIT)
         .set_depth_format(m_depth_image.get_format())
         .set_depth_access(VK_TRUE, VK_TRUE)
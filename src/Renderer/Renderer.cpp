@@ -187,6 +187,7 @@ void pvp::Renderer::draw()
 
     ZoneScoped;
     prepare_frame();
+    m_scene.record_transfers(m_frame_contexts[m_double_buffer_frame], m_frame_waits);
     if (!m_scene.get_meshlets_enabeled())
     {
         m_depth_pre_pass.draw(m_frame_contexts[m_double_buffer_frame]);
@@ -213,11 +214,24 @@ void pvp::Renderer::end_frame()
     VK_CALL(vkEndCommandBuffer(m_frame_contexts.at(m_double_buffer_frame).command_buffer));
 
     ZoneNamedN(submit_queue, "submit queue", true);
-    VkSemaphoreSubmitInfo acquire_semaphores{
-        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
-        .semaphore = m_frame_syncers.acquire_semaphores.at(m_double_buffer_frame).handle,
-        .stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+    std::vector<VkSemaphoreSubmitInfo> wait_semaphores{
+        VkSemaphoreSubmitInfo{
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+            .semaphore = m_frame_syncers.acquire_semaphores.at(m_double_buffer_frame).handle,
+            .stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+        },
     };
+    // Transfers submitted on their own are waited on by the GPU, the CPU never blocks on them
+    for (const SubmitTicket& ticket : m_frame_waits)
+    {
+        wait_semaphores.push_back(VkSemaphoreSubmitInfo{
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+            .semaphore = ticket.semaphore,
+            .value = ticket.value,
+            .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        });
+    }
+    m_frame_waits.clear();
 
     std::array cmd_submit_info{
         VkCommandBufferSubmitInfo{
@@ -234,8 +248,8 @@ void pvp::Renderer::end_frame()
 
     VkSubmitInfo2 submit_info{
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
-        .waitSemaphoreInfoCount = 1,
-        .pWaitSemaphoreInfos = &acquire_semaphores,
+        .waitSemaphoreInfoCount = static_cast<uint32_t>(wait_semaphores.size()),
+        .pWaitSemaphoreInfos = wait_semaphores.data(),
 
         .commandBufferInfoCount = cmd_submit_info.size(),
         .pCommandBufferInfos = cmd_submit_info.data(),
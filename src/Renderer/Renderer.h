@@ -53,6 +53,7 @@ namespace pvp
 
         CommandPool                                    m_cmd_pool_graphics_present;
         std::array<FrameContext, max_frames_in_flight> m_frame_contexts{};
+        std::vector<SubmitTicket>                      m_frame_waits; // Uploads on other submits the frame reads from
 
         DepthPrePass    m_depth_pre_pass;
         GBuffer         m_geometry_draw;
@@ -0,0 +1,331 @@
+﻿#include "GeometryStreamer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include <Buffer/BufferBuilder.h>
+#include <Context/Device.h>
+#include <VMAAllocator/VmaAllocator.h>
+#include <spdlog/spdlog.h>
+#include <tracy/Tracy.hpp>
+
+namespace
+{
+    VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    // Everything that reads scene geometry or the draw and pointer tables
+    constexpr VkPipelineStageFlags2 geometry_read_stages = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT |
+        VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_TASK_SHADER_BIT_EXT | VK_PIPELINE_STAGE_2_MESH_SHADER_BIT_EXT;
+    constexpr VkAccessFlags2 geometry_read_access = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT |
+        VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+} // namespace
+
+pvp::GeometryStreamer::GeometryStreamer(Context& context, CachedScene&& scene, VkDeviceSize pool_size, VkDeviceSize upload_budget)
+    : m_context{ context }
+    , m_scene{ std::move(scene) }
+    , m_models(m_scene.models.size())
+    , m_upload_budget{ upload_budget }
+    , m_table_reserve{ (m_scene.instances.size() + m_scene.models.size()) * table_bytes_per_entry + 2 * StagingRing::default_alignment }
+    , m_staging{ context, (upload_budget + m_table_reserve) * (max_frames_in_flight + 1) }
+{
+    ZoneScoped;
+    BufferBuilder()
+        .set_size(pool_size)
+        .set_usage(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                   VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT)
+        .set_memory_usage(VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE)
+        .build(m_context.allocator->get_allocator(), m_pool);
+
+    m_pool_address = m_pool.get_device_address();
+
+    const VmaVirtualBlockCreateInfo block_info{ .size = pool_size };
+    if (vmaCreateVirtualBlock(&block_info, &m_pool_block) != VK_SUCCESS)
+    {
+        m_pool.destroy();
+        throw std::runtime_error("Can't create streaming pool");
+    }
+    spdlog::info("Streaming {} models through a {} MiB pool", m_models.size(), pool_size >> 20);
+}
+
+pvp::GeometryStreamer::~GeometryStreamer()
+{
+    // The owner waits for the device before letting go of the streamer
+    for (DestructorQueue& releases : m_frame_releases)
+    {
+        releases.destroy_and_clear();
+    }
+    vmaClearVirtualBlock(m_pool_block);
+    vmaDestroyVirtualBlock(m_pool_block);
+    m_pool.destroy();
+}
+
+void pvp::GeometryStreamer::request(uint32_t model_index, float priority)
+{
+    m_models[model_index].priority = std::max(m_models[model_index].priority, priority);
+}
+
+bool pvp::GeometryStreamer::update()
+{
+    ZoneScoped;
+    ++m_frame;
+
+    std::vector<uint32_t> wanted;
+    for (uint32_t i = 0; i < m_models.size(); ++i)
+    {
+        StreamedModel& model = m_models[i];
+        if (model.priority > 0.0f)
+        {
+            model.last_wanted_frame = m_frame;
+            if (!model.is_resident() && !model.too_large)
+            {
+                wanted.push_back(i);
+            }
+        }
+    }
+    std::ranges::sort(wanted, std::greater{}, [&](uint32_t i) { return m_models[i].priority; });
+
+    m_residency_changed = false;
+    if (!wanted.empty() && !m_table_staging.has_value())
+    {
+        // Taken before any page in, a residency change always leaves room to rewrite the tables
+        m_table_staging = m_staging.allocate(m_table_reserve);
+        m_table_staging_used = 0;
+    }
+    if (!m_table_staging.has_value())
+    {
+        if (!wanted.empty())
+        {
+            ++m_staging_stalls;
+        }
+        wanted.clear();
+    }
+
+    VkDeviceSize uploaded{};
+    for (const uint32_t model_index : wanted)
+    {
+        if (uploaded >= m_upload_budget)
+        {
+            break;
+        }
+        if (page_in(model_index))
+        {
+            uploaded += m_models[model_index].size;
+        }
+        else if (!m_models[model_index].too_large)
+        {
+            break;
+        }
+    }
+
+    for (StreamedModel& model : m_models)
+    {
+        model.priority = 0.0f;
+    }
+    return m_residency_changed;
+}
+
+bool pvp::GeometryStreamer::page_in(uint32_t model_index)
+{
+    ZoneScoped;
+    const CachedModel& cpu_model = m_scene.models[model_index];
+    StreamedModel&     model = m_models[model_index];
+
+    // Runs in the middle of the frame, a model the compact encoding can't hold is left out like one too large for the pool
+    CompactMeshlets compact;
+    try
+    {
+        compact = compact_meshlets(cpu_model);
+    }
+    catch (const std::runtime_error& error)
+    {
+        spdlog::warn("Model {} can't be streamed: {}", model_index, error.what());
+        model.too_large = true;
+        return false;
+    }
+
+    // Sections back to back in one allocation, the same streams the scene wide buffers hold
+    VkDeviceSize size{};
+    auto         section = [&](VkDeviceSize bytes) {
+        const VkDeviceSize offset = align_up(size, section_alignment);
+        size = offset + bytes;
+        return offset;
+    };
+    const std::array sections{
+        std::pair{ section(cpu_model.vertex_bytes().size_bytes()), cpu_model.vertex_bytes() },
+        std::pair{ section(std::as_bytes(cpu_model.indices).size_bytes()), std::as_bytes(cpu_model.indices) },
+        std::pair{ section(std::as_bytes(std::span(compact.meshlets)).size_bytes()), std::as_bytes(std::span(compact.meshlets)) },
+        std::pair{ section(std::as_bytes(std::span(compact.vertices)).size_bytes()), std::as_bytes(std::span(compact.vertices)) },
+        std::pair{ section(std::as_bytes(std::span(compact.triangles)).size_bytes()), std::as_bytes(std::span(compact.triangles)) },
+        std::pair{ section(std::as_bytes(cpu_model.meshlet_sphere_bounds).size_bytes()), std::as_bytes(cpu_model.meshlet_sphere_bounds) },
+        std::pair{ section(std::as_bytes(cpu_model.meshlet_lods).size_bytes()), std::as_bytes(cpu_model.meshlet_lods) },
+    };
+
+    if (size > m_pool.get_size() || size + m_table_reserve > m_staging.get_size())
+    {
+        spdlog::warn("Model {} needs {} bytes, more than the whole streaming pool or staging ring", model_index, size);
+        model.too_large = true;
+        return false;
+    }
+    // Checked before evicting anything for it
+    if (!m_staging.fits(size))
+    {
+        ++m_staging_stalls;
+        return false;
+    }
+
+    VkDeviceSize offset{};
+    if (!allocate(model_index, size, offset))
+    {
+        return false;
+    }
+
+    const StagingRegion source = m_staging.allocate(size).value();
+    for (const auto& [section_offset, bytes] : sections)
+    {
+        std::memcpy(source.memory.data() + section_offset, bytes.data(), bytes.size_bytes());
+    }
+    m_pending_copies.push_back(PendingCopy{ source, m_pool.get_buffer(), offset });
+
+    model.size = size;
+    model.vertex_offset = offset + sections[0].first;
+    model.index_offset = offset + sections[1].first;
+    model.meshlet_offset = offset + sections[2].first;
+    model.meshlet_vertices_offset = offset + sections[3].first;
+    model.meshlet_triangles_offset = offset + sections[4].first;
+    model.meshlet_sphere_bounds_offset = offset + sections[5].first;
+    model.meshlet_lod_offset = offset + sections[6].first;
+    ++m_resident_count;
+    m_residency_changed = true;
+    return true;
+}
+
+bool pvp::GeometryStreamer::allocate(uint32_t model_index, VkDeviceSize size, VkDeviceSize& offset)
+{
+    StreamedModel&                       model = m_models[model_index];
+    const VmaVirtualAllocationCreateInfo allocation_info{ .size = size, .alignment = section_alignment };
+    if (vmaVirtualAllocate(m_pool_block, &allocation_info, &model.allocation, &offset) == VK_SUCCESS)
+    {
+        return true;
+    }
+    model.allocation = VK_NULL_HANDLE;
+
+    // Evicted ranges only return to the pool once the frames still reading them are done, so retrying right away
+    // can't succeed. Evict until the ranges on their way back cover this model and page it in on a later frame
+    while (m_pending_free_bytes < size)
+    {
+        // Make room by dropping the least wanted resident model, never one wanted as much as this one
+        uint32_t victim = static_cast<uint32_t>(m_models.size());
+        for (uint32_t i = 0; i < m_models.size(); ++i)
+        {
+            const StreamedModel& candidate = m_models[i];
+            if (!candidate.is_resident() || candidate.priority >= model.priority)
+            {
+                continue;
+            }
+            if (victim == m_models.size() || candidate.priority < m_models[victim].priority ||
+                (candidate.priority == m_models[victim].priority && candidate.last_wanted_frame < m_models[victim].last_wanted_frame))
+            {
+                victim = i;
+            }
+        }
+        if (victim == m_models.size())
+        {
+            // Whatever is left is wanted more
+            break;
+        }
+        evict(victim);
+    }
+    return false;
+}
+
+void pvp::GeometryStreamer::evict(uint32_t model_index)
+{
+    StreamedModel& model = m_models[model_index];
+    m_retired_allocations.push_back(RetiredAllocation{ model.allocation, model.size });
+    m_pending_free_bytes += model.size;
+    model.allocation = VK_NULL_HANDLE;
+    --m_resident_count;
+    m_residency_changed = true;
+}
+
+void pvp::GeometryStreamer::record(VkCommandBuffer cmd, uint32_t frame_index)
+{
+    ZoneScoped;
+    // This slot's fence was waited on, the frame that retired these ranges and every frame before it are done
+    DestructorQueue& releases = m_frame_releases[frame_index];
+    releases.destroy_and_clear();
+    for (const RetiredAllocation& retired : m_retired_allocations)
+    {
+        releases.add_to_queue([this, retired] {
+            vmaVirtualFree(m_pool_block, retired.allocation);
+            m_pending_free_bytes -= retired.size;
+        });
+    }
+    m_retired_allocations.clear();
+    if (m_frame_staging[frame_index].has_value())
+    {
+        m_staging.release(m_frame_staging[frame_index].value());
+        m_frame_staging[frame_index].reset();
+    }
+
+    if (m_pending_copies.empty())
+    {
+        return;
+    }
+
+    VkMemoryBarrier2 barrier{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = geometry_read_stages,
+        .srcAccessMask = VK_ACCESS_2_NONE,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+        .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+    };
+    VkDependencyInfo dependency{ .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .memoryBarrierCount = 1, .pMemoryBarriers = &barrier };
+    vkCmdPipelineBarrier2(cmd, &dependency);
+
+    for (const PendingCopy& copy : m_pending_copies)
+    {
+        const VkBufferCopy region{ copy.source.offset, copy.destination_offset, copy.source.memory.size_bytes() };
+        vkCmdCopyBuffer(cmd, copy.source.buffer, copy.destination, 1, &region);
+    }
+    m_pending_copies.clear();
+    m_table_staging.reset();
+    m_frame_staging[frame_index] = m_staging.mark();
+
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    barrier.dstStageMask = geometry_read_stages;
+    barrier.dstAccessMask = geometry_read_access;
+    vkCmdPipelineBarrier2(cmd, &dependency);
+}
+
+// Out of the space update() set aside, or straight from the ring for the tables written before the first update
+pvp::StagingRegion pvp::GeometryStreamer::allocate_staging(VkDeviceSize size)
+{
+    if (m_table_staging.has_value())
+    {
+        const VkDeviceSize offset = align_up(m_table_staging_used, StagingRing::default_alignment);
+        if (offset + size <= m_table_staging->memory.size_bytes())
+        {
+            m_table_staging_used = offset + size;
+            return StagingRegion{ m_table_staging->buffer, m_table_staging->offset + offset, m_table_staging->memory.subspan(offset, size) };
+        }
+    }
+    std::optional<StagingRegion> region = m_staging.allocate(size);
+    if (!region.has_value())
+    {
+        throw std::runtime_error("Streaming tables don't fit in the staging ring");
+    }
+    return region.value();
+}
+
+VkDeviceSize pvp::GeometryStreamer::get_resident_bytes() const
+{
+    VmaStatistics statistics{};
+    vmaGetVirtualBlockStatistics(m_pool_block, &statistics);
+    return statistics.allocationBytes;
+}
@@ -0,0 +1,157 @@
+﻿#pragma once
+#include "ModelData.h"
+
+#include <DestructorQueue.h>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <globalconst.h>
+#include <optional>
+#include <span>
+#include <vector>
+#include <Buffer/Buffer.h>
+#include <Buffer/StagingRing.h>
+#include <Context/Context.h>
+#include <vma/vk_mem_alloc.h>
+
+namespace pvp
+{
+    // Byte offsets of a resident model's sections inside the pool buffer
+    struct StreamedModel
+    {
+        VmaVirtualAllocation allocation{ VK_NULL_HANDLE }; // Null while not resident
+        VkDeviceSize         size{};
+        VkDeviceSize         vertex_offset{};
+        VkDeviceSize         index_offset{};
+        VkDeviceSize         meshlet_offset{};
+        VkDeviceSize         meshlet_vertices_offset{};
+        VkDeviceSize         meshlet_triangles_offset{};
+        VkDeviceSize         meshlet_sphere_bounds_offset{};
+        VkDeviceSize         meshlet_lod_offset{};
+
+        float    priority{};          // Highest request this frame, 0 when nothing asked for it
+        uint64_t last_wanted_frame{}; // Breaks ties between unwanted models, the longest unused goes first
+        bool     too_large{};         // Needs more than the whole pool or the compact meshlet encoding, never paged in
+
+        [[nodiscard]] bool is_resident() const
+        {
+            return allocation != VK_NULL_HANDLE;
+        }
+    };
+
+    // Residency manager for scenes larger than VRAM. Model geometry stays in the cache file mapping and is paged into
+    // a fixed size device buffer by priority, evicting the least wanted models when it runs out of room.
+    // Everything copied in is staged in a ring of its own and recorded into the frame command buffer, ring space and
+    // evicted ranges are released once that frame slot comes around again so frames still in flight keep reading valid data.
+    class GeometryStreamer final
+    {
+    public:
+        explicit GeometryStreamer(Context& context, CachedScene&& scene, VkDeviceSize pool_size, VkDeviceSize upload_budget);
+        ~GeometryStreamer();
+        DISABLE_COPY(GeometryStreamer);
+        DISABLE_MOVE(GeometryStreamer);
+
+        // Keeps the highest priority asked for a model this frame
+        void request(uint32_t model_index, float priority);
+        // Pages in the most wanted models that fit in this frame's upload budget and clears the requests.
+        // Returns true when any model became resident or got evicted.
+        bool update();
+        // Copies data into a device buffer in the same transfer as the page ins. Fits in what update() set aside as long
+        // as it's no larger than the draw and pointer tables
+        template<typename T>
+        void stage(std::span<const T> data, const Buffer& destination, VkDeviceSize destination_offset = 0);
+        // Records every pending copy between barriers against the draws of earlier frames and this one
+        void record(VkCommandBuffer cmd, uint32_t frame_index);
+
+        [[nodiscard]] const CachedScene& get_scene() const
+        {
+            return m_scene;
+        }
+        [[nodiscard]] const Buffer& get_pool() const
+        {
+            return m_pool;
+        }
+        [[nodiscard]] VkDeviceAddress get_pool_address() const
+        {
+            return m_pool_address;
+        }
+        [[nodiscard]] std::span<const StreamedModel> get_models() const
+        {
+            return m_models;
+        }
+        [[nodiscard]] VkDeviceSize get_pool_size() const
+        {
+            return m_pool.get_size();
+        }
+        [[nodiscard]] VkDeviceSize get_resident_bytes() const;
+        [[nodiscard]] uint32_t     get_resident_count() const
+        {
+            return m_resident_count;
+        }
+        [[nodiscard]] const StagingRing& get_staging() const
+        {
+            return m_staging;
+        }
+        // Frames that stopped paging in because the staging ring was still held by frames in flight
+        [[nodiscard]] uint64_t get_staging_stalls() const
+        {
+            return m_staging_stalls;
+        }
+
+    private:
+        struct PendingCopy
+        {
+            StagingRegion source;
+            VkBuffer      destination;
+            VkDeviceSize  destination_offset;
+        };
+        struct RetiredAllocation
+        {
+            VmaVirtualAllocation allocation;
+            VkDeviceSize         size;
+        };
+
+        StagingRegion allocate_staging(VkDeviceSize size);
+
+        bool page_in(uint32_t model_index);
+        void evict(uint32_t model_index);
+        bool allocate(uint32_t model_index, VkDeviceSize size, VkDeviceSize& offset);
+
+        Context&                     m_context;
+        CachedScene                  m_scene;
+        std::vector<StreamedModel>   m_models;
+        Buffer                       m_pool;
+        VkDeviceAddress              m_pool_address{};
+        VmaVirtualBlock              m_pool_block{ VK_NULL_HANDLE };
+        VkDeviceSize                 m_upload_budget;
+        VkDeviceSize                 m_table_reserve; // Staging set aside for the tables rewritten after a residency change
+        StagingRing                  m_staging;
+        std::optional<StagingRegion> m_table_staging;
+        VkDeviceSize                 m_table_staging_used{};
+        uint64_t                     m_staging_stalls{};
+        uint64_t                     m_frame{};
+        uint32_t                     m_resident_count{};
+        bool                         m_residency_changed{};
+        VkDeviceSize                 m_pending_free_bytes{}; // Evicted but still read by frames in flight, not free in the pool yet
+
+        std::vector<PendingCopy>                                  m_pending_copies;
+        std::vector<RetiredAllocation>                            m_retired_allocations;
+        std::array<DestructorQueue, max_frames_in_flight>         m_frame_releases;
+        std::array<std::optional<uint64_t>, max_frames_in_flight> m_frame_staging; // Ring mark of the copies each slot recorded
+
+        constexpr static VkDeviceSize section_alignment{ 16 };
+        constexpr static VkDeviceSize table_bytes_per_entry{ 64 }; // At least a DrawCommandIndirect or MeshletsBuffers
+    };
+
+    template<typename T>
+    void GeometryStreamer::stage(std::span<const T> data, const Buffer& destination, VkDeviceSize destination_offset)
+    {
+        if (data.empty())
+        {
+            return;
+        }
+        const StagingRegion source = allocate_staging(data.size_bytes());
+        std::memcpy(source.memory.data(), data.data(), data.size_bytes());
+        m_pending_copies.push_back(PendingCopy{ source, destination.get_buffer(), destination.get_offset() + destination_offset });
+    }
+} // namespace pvp
@@ -0,0 +1,79 @@
+﻿#include "LodSelection.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <tracy/Tracy.hpp>
+
+void pvp::LodSelectionInput::add(const glm::vec3& center, float sphere_radius, std::span<const float> level_errors)
+{
+    center_x.push_back(center.x);
+    center_y.push_back(center.y);
+    center_z.push_back(center.z);
+    radius.push_back(sphere_radius);
+
+    for (uint32_t level = 0; level < max_index_lods; ++level)
+    {
+        errors[level].push_back(level < level_errors.size() ? level_errors[level] : std::numeric_limits<float>::max());
+    }
+    coarsest_lod.push_back(static_cast<uint8_t>(std::clamp<size_t>(level_errors.size(), 1, max_index_lods) - 1));
+}
+
+void pvp::LodSelectionInput::clear()
+{
+    center_x.clear();
+    center_y.clear();
+    center_z.clear();
+    radius.clear();
+    for (std::vector<float>& level_errors : errors)
+    {
+        level_errors.clear();
+    }
+    coarsest_lod.clear();
+}
+
+void pvp::select_lods(const LodSelectionInput& input, const LodSelectionView& view, std::span<uint8_t> lods_out)
+{
+    ZoneScoped;
+    const size_t count = std::min(input.size(), lods_out.size());
+    const float  pixels_to_error = view.pixel_error / view.error_scale;
+    const float  coverage_to_radius = view.min_coverage / view.error_scale;
+    const float  camera_x = view.camera_position.x;
+    const float  camera_y = view.camera_position.y;
+    const float  camera_z = view.camera_position.z;
+    const float  near_plane = view.near_plane;
+
+    // Raw pointers because the byte sized output may alias anything, which would reload the vectors every iteration
+    const float* const   center_x = input.center_x.data();
+    const float* const   center_y = input.center_y.data();
+    const float* const   center_z = input.center_z.data();
+    const float* const   radius = input.radius.data();
+    const uint8_t* const coarsest_lod = input.coarsest_lod.data();
+    uint8_t* const       out = lods_out.data();
+
+    std::array<const float*, max_index_lods> errors{};
+    for (uint32_t level = 0; level < max_index_lods; ++level)
+    {
+        errors[level] = input.errors[level].data();
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float x = center_x[i] - camera_x;
+        const float y = center_y[i] - camera_y;
+        const float z = center_z[i] - camera_z;
+        const float distance = std::max(std::sqrt(x * x + y * y + z * z) - radius[i], near_plane);
+
+        // Compared in world space so the loop needs no division. Expanded at compile time, a nested loop keeps
+        // compilers from vectorizing the outer one
+        const float    allowed_error = pixels_to_error * distance;
+        const uint32_t lod = [&]<uint32_t... level>(std::integer_sequence<uint32_t, level...>) {
+            return (static_cast<uint32_t>(errors[level + 1][i] <= allowed_error) + ...);
+        }(std::make_integer_sequence<uint32_t, max_index_lods - 1>{});
+
+        // Missing levels have float max errors so lod never passes the coarsest one
+        const uint32_t too_small = static_cast<uint32_t>(radius[i] < coverage_to_radius * distance);
+        out[i] = static_cast<uint8_t>(std::max(lod, coarsest_lod[i] * too_small));
+    }
+}
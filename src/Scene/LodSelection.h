@@ -0,0 +1,47 @@
+﻿#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glm/vec3.hpp>
+
+namespace pvp
+{
+    // Index buffer levels per model, full detail included
+    constexpr uint32_t max_index_lods = 5;
+
+    // Instance bounds and level errors as structure of arrays so select_lods runs over plain float streams
+    struct LodSelectionInput
+    {
+        std::vector<float> center_x;
+        std::vector<float> center_y;
+        std::vector<float> center_z;
+        std::vector<float> radius;
+
+        // World space error per level and instance. Levels a model does not have are float max
+        std::array<std::vector<float>, max_index_lods> errors;
+        std::vector<uint8_t>                           coarsest_lod;
+
+        void add(const glm::vec3& center, float sphere_radius, std::span<const float> level_errors);
+        void clear();
+
+        [[nodiscard]] size_t size() const
+        {
+            return radius.size();
+        }
+    };
+
+    struct LodSelectionView
+    {
+        glm::vec3 camera_position;
+        float     near_plane;
+        float     error_scale;     // Turns a world space size over its distance into pixels, projection[1][1] * 0.5 * viewport height
+        float     pixel_error;     // Largest error in pixels a level may show
+        float     min_coverage{};  // Spheres with a smaller projected radius in pixels draw their coarsest level
+    };
+
+    // Picks the coarsest level per instance whose error, projected at the nearest point of the bounding sphere, stays
+    // under view.pixel_error. Level errors have to grow with the level. Branch free so the compiler can vectorize it.
+    void select_lods(const LodSelectionInput& input, const LodSelectionView& view, std::span<uint8_t> lods_out);
+} // namespace pvp
@@ -0,0 +1,122 @@
+﻿#include "MappedFile.h"
+
+#include <utility>
+#include <spdlog/spdlog.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+pvp::MappedFile::MappedFile(const std::filesystem::path& path)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        spdlog::error("Can't open {} for mapping", path.string());
+        return;
+    }
+    m_file_handle = file;
+
+    LARGE_INTEGER file_size{};
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+    {
+        close();
+        return;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+    {
+        spdlog::error("Can't create file mapping for {}", path.string());
+        close();
+        return;
+    }
+    m_mapping_handle = mapping;
+
+    m_data = static_cast<const std::byte*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    m_size = m_data != nullptr ? static_cast<size_t>(file_size.QuadPart) : 0;
+#else
+    m_file_descriptor = open(path.c_str(), O_RDONLY);
+    if (m_file_descriptor < 0)
+    {
+        spdlog::error("Can't open {} for mapping", path.string());
+        return;
+    }
+
+    struct stat file_stat{};
+    if (fstat(m_file_descriptor, &file_stat) != 0 || file_stat.st_size == 0)
+    {
+        close();
+        return;
+    }
+
+    void* data = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, m_file_descriptor, 0);
+    if (data == MAP_FAILED)
+    {
+        spdlog::error("Can't map {}", path.string());
+        close();
+        return;
+    }
+    madvise(data, static_cast<size_t>(file_stat.st_size), MADV_SEQUENTIAL);
+
+    m_data = static_cast<const std::byte*>(data);
+    m_size = static_cast<size_t>(file_stat.st_size);
+#endif
+}
+
+pvp::MappedFile::~MappedFile()
+{
+    close();
+}
+
+pvp::MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+pvp::MappedFile& pvp::MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other)
+    {
+        close();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+#ifdef _WIN32
+        m_file_handle = std::exchange(other.m_file_handle, nullptr);
+        m_mapping_handle = std::exchange(other.m_mapping_handle, nullptr);
+#else
+        m_file_descriptor = std::exchange(other.m_file_descriptor, -1);
+#endif
+    }
+    return *this;
+}
+
+void pvp::MappedFile::close()
+{
+#ifdef _WIN32
+    if (m_data != nullptr)
+        UnmapViewOfFile(m_data);
+    if (m_mapping_handle != nullptr)
+        CloseHandle(m_mapping_handle);
+    if (m_file_handle != nullptr)
+        CloseHandle(m_file_handle);
+    m_file_handle = nullptr;
+    m_mapping_handle = nullptr;
+#else
+    if (m_data != nullptr)
+        munmap(const_cast<std::byte*>(m_data), m_size);
+    if (m_file_descriptor >= 0)
+        ::close(m_file_descriptor);
+    m_file_descriptor = -1;
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
@@ -0,0 +1,54 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <globalconst.h>
+
+namespace pvp
+{
+    // Read only memory mapping of a whole file. Used so cache sections can be handed out as spans without copying.
+    class MappedFile final
+    {
+    public:
+        explicit MappedFile() = default;
+        explicit MappedFile(const std::filesystem::path& path);
+        ~MappedFile();
+        DISABLE_COPY(MappedFile);
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+        [[nodiscard]] bool is_open() const
+        {
+            return m_data != nullptr;
+        }
+
+        [[nodiscard]] std::span<const std::byte> get_data() const
+        {
+            return { m_data, m_size };
+        }
+
+        // Returns an empty span when the range falls outside of the mapping.
+        template<typename T>
+        [[nodiscard]] std::span<const T> get_span(uint64_t byte_offset, uint64_t byte_size) const
+        {
+            if (byte_offset > m_size || byte_size > m_size - byte_offset || byte_size % sizeof(T) != 0)
+            {
+                return {};
+            }
+            return { reinterpret_cast<const T*>(m_data + byte_offset), static_cast<size_t>(byte_size / sizeof(T)) };
+        }
+
+    private:
+        void close();
+
+        const std::byte* m_data{};
+        size_t           m_size{};
+#ifdef _WIN32
+        void* m_file_handle{};
+        void* m_mapping_handle{};
+#else
+        int m_file_descriptor{ -1 };
+#endif
+    };
+} // namespace pvp
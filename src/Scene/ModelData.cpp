@@ -1,16 +1,37 @@
 ﻿#include "ModelData.h"
 
+#include "LodSelection.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bc7enc.h>
+#include <bit>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <execution>
 #include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
 #include <meshoptimizer.h>
+#include <mutex>
+#include <new>
 #include <numeric>
 #include <set>
 #include <stb_image.h>
+#include <thread>
+#include <unordered_map>
 #include <GraphicsPipeline/Vertex.h>
-#include <Image/Image.h>
+#include <assimp/DefaultIOSystem.h>
+#include <assimp/Importer.hpp>
 #include <assimp/cimport.h>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
+#include <glm/common.hpp>
 #include <glm/fwd.hpp>
+#include <glm/geometric.hpp>
 #include <glm/mat4x4.hpp>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
@@ -18,6 +39,9 @@
 #include <tracy/Tracy.hpp>
 #include <dds.hpp>
 #include <PodHelpers.h>
+#include <rgbcx.h>
+#include <xxhash.h>
+#include <zstd.h>
 
 namespace
 {
@@ -102,283 +126,2038 @@ namespace
         file.close();
     }
 
-    void generate_meshlet(pvp::ModelData& model_out)
+    // Everything that changes the import output has to be part of import_settings_hash.
+    constexpr unsigned int import_flags = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals | aiProcess_CalcTangentSpace;
+    constexpr float        overdraw_threshold = 1.05f; // Allowed vertex cache hit ratio loss for less overdraw
+    constexpr size_t       meshlet_group_size = 8;     // Meshlets simplified together per level of the meshlet hierarchy
+    constexpr uint32_t     max_meshlet_lod_levels = 16;
+    constexpr float        min_lod_reduction = 0.85f;  // Groups that keep more of their indices than this stop simplifying
+    constexpr float        index_lod_reduction = 0.5f; // Index count of each discrete level relative to the one before
+    constexpr uint32_t     meshlet_offset_bits = 24;   // See GpuMeshlet
+    constexpr uint32_t     meshlet_offset_mask = (1u << meshlet_offset_bits) - 1u;
+    constexpr uint32_t     short_meshlet_vertices_bit = 1u << 31;
+
+    uint64_t import_settings_hash(const pvp::ImportSettings& import_settings)
     {
-        constexpr size_t max_vertices = 64;
-        constexpr size_t max_triangles = 126;
-        constexpr float  cone_weight = 0.25f;
+        const pvp::MeshletSettings&    meshlets = import_settings.meshlets;
+        const std::array<uint64_t, 19> settings{
+            import_flags,
+            static_cast<uint64_t>(meshlets.builder),
+            meshlets.max_vertices,
+            meshlets.max_triangles,
+            meshlets.min_triangles,
+            std::bit_cast<uint32_t>(meshlets.cone_weight),
+            std::bit_cast<uint32_t>(meshlets.split_factor),
+            std::bit_cast<uint32_t>(meshlets.fill_weight),
+            static_cast<uint64_t>(import_settings.vertex_format),
+            static_cast<uint64_t>(import_settings.cache_compression),
+            static_cast<uint64_t>(import_settings.texture_compression),
+            static_cast<uint64_t>(import_settings.mesh_optimization),
+            std::bit_cast<uint32_t>(overdraw_threshold),
+            static_cast<uint64_t>(import_settings.meshlet_lods),
+            meshlet_group_size,
+            max_meshlet_lod_levels,
+            std::bit_cast<uint32_t>(min_lod_reduction),
+            pvp::max_index_lods,
+            std::bit_cast<uint32_t>(index_lod_reduction),
+        };
+        return XXH3_64bits(settings.data(), sizeof(settings));
+    }
+
+    uint64_t hash_file(const fs::path& path)
+    {
+        ZoneScoped;
+        const pvp::MappedFile            file(path);
+        const std::span<const std::byte> data = file.get_data();
+        return XXH3_64bits(data.data(), data.size());
+    }
+
+    int64_t write_time(const fs::path& path)
+    {
+        std::error_code error;
+        const auto      time = fs::last_write_time(path, error);
+        return error ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+    }
+
+    // Forwards to the default IO system and remembers every file assimp opens (.bin buffers, .mtl files, ...)
+    class RecordingIOSystem final : public Assimp::DefaultIOSystem
+    {
+    public:
+        explicit RecordingIOSystem(std::set<std::string>& opened_files)
+            : m_opened_files{ opened_files }
+        {
+        }
+
+        Assimp::IOStream* Open(const char* file, const char* mode) override
+        {
+            Assimp::IOStream* stream = DefaultIOSystem::Open(file, mode);
+            if (stream != nullptr)
+            {
+                m_opened_files.insert(fs::path(file).generic_string());
+            }
+            return stream;
+        }
+
+    private:
+        std::set<std::string>& m_opened_files;
+    };
+
+    // Welds duplicates and reorders triangles and vertices for the post transform cache, overdraw and fetch locality.
+    // Meshlets built afterwards pack denser and the indexed CPU path draws the same buffers.
+    void optimize_mesh(pvp::ModelData& model, pvp::MeshOptimization passes)
+    {
+        ZoneScoped;
+        if (model.indices.empty() || model.vertices.empty())
+        {
+            return;
+        }
+
+        if (has_pass(passes, pvp::MeshOptimization::remap))
+        {
+            // Compared per attribute so the alignment padding inside Vertex does not keep duplicates apart
+            const std::array<meshopt_Stream, 4> streams{
+                meshopt_Stream{ &model.vertices[0].pos, sizeof(glm::vec3), sizeof(pvp::Vertex) },
+                meshopt_Stream{ &model.vertices[0].uv, sizeof(glm::vec2), sizeof(pvp::Vertex) },
+                meshopt_Stream{ &model.vertices[0].normal, sizeof(glm::vec3), sizeof(pvp::Vertex) },
+                meshopt_Stream{ &model.vertices[0].tangent, sizeof(glm::vec3), sizeof(pvp::Vertex) },
+            };
+            std::vector<unsigned int> remap(model.vertices.size());
+            const size_t              unique_vertex_count = meshopt_generateVertexRemapMulti(
+                remap.data(), model.indices.data(), model.indices.size(), model.vertices.size(), streams.data(), streams.size());
+
+            std::vector<pvp::Vertex> vertices(unique_vertex_count);
+            meshopt_remapVertexBuffer(vertices.data(), model.vertices.data(), model.vertices.size(), sizeof(pvp::Vertex), remap.data());
+            meshopt_remapIndexBuffer(model.indices.data(), model.indices.data(), model.indices.size(), remap.data());
+            model.vertices = std::move(vertices);
+        }
+
+        if (has_pass(passes, pvp::MeshOptimization::vertex_cache))
+        {
+            meshopt_optimizeVertexCache(model.indices.data(), model.indices.data(), model.indices.size(), model.vertices.size());
+        }
+
+        if (has_pass(passes, pvp::MeshOptimization::overdraw))
+        {
+            meshopt_optimizeOverdraw(model.indices.data(),
+                                     model.indices.data(),
+                                     model.indices.size(),
+                                     &model.vertices[0].pos.x,
+                                     model.vertices.size(),
+                                     sizeof(pvp::Vertex),
+                                     overdraw_threshold);
+        }
+
+        if (has_pass(passes, pvp::MeshOptimization::vertex_fetch))
+        {
+            const size_t vertex_count = meshopt_optimizeVertexFetch(model.vertices.data(),
+                                                                    model.indices.data(),
+                                                                    model.indices.size(),
+                                                                    model.vertices.data(),
+                                                                    model.vertices.size(),
+                                                                    sizeof(pvp::Vertex));
+            model.vertices.resize(vertex_count);
+        }
+
+        model.optimization_passes = passes;
+    }
+
+    std::vector<float> vertex_positions(const pvp::ModelData& model)
+    {
+        std::vector<float> positions;
+        positions.reserve(model.vertices.size() * 3);
+        for (const pvp::Vertex& vertex : model.vertices)
+        {
+            positions.push_back(vertex.pos.x);
+            positions.push_back(vertex.pos.y);
+            positions.push_back(vertex.pos.z);
+        }
+        return positions;
+    }
+
+    // Clusters the triangles into meshlets appended behind the ones the model already has
+    size_t build_meshlets(const pvp::MeshletSettings& settings,
+                          std::vector<meshopt_Meshlet>& meshlets,
+                          std::vector<uint32_t>&        meshlet_vertices,
+                          std::vector<uint8_t>&         meshlet_triangles,
+                          std::span<const uint32_t>     indices,
+                          const std::vector<float>&     vertices)
+    {
+        // flex and spatial size their bound by the smallest meshlet they may emit
+        const size_t bound_triangles = settings.builder == pvp::MeshletBuilder::scan ? settings.max_triangles : settings.min_triangles;
+        const size_t max_mesh_lets = meshopt_buildMeshletsBound(indices.size(), settings.max_vertices, bound_triangles);
+        meshlets.resize(max_mesh_lets);
+        meshlet_vertices.resize(max_mesh_lets * settings.max_vertices);
+        meshlet_triangles.resize(max_mesh_lets * settings.max_triangles * 3);
+
+        switch (settings.builder)
+        {
+            case pvp::MeshletBuilder::flex:
+                return meshopt_buildMeshletsFlex(meshlets.data(), meshlet_vertices.data(), meshlet_triangles.data(), indices.data(), indices.size(), vertices.data(), vertices.size() / 3, sizeof(float) * 3, settings.max_vertices, settings.min_triangles, settings.max_triangles, settings.cone_weight, settings.split_factor);
+            case pvp::MeshletBuilder::spatial:
+                return meshopt_buildMeshletsSpatial(meshlets.data(), meshlet_vertices.data(), meshlet_triangles.data(), indices.data(), indices.size(), vertices.data(), vertices.size() / 3, sizeof(float) * 3, settings.max_vertices, settings.min_triangles, settings.max_triangles, settings.fill_weight);
+            case pvp::MeshletBuilder::scan:
+            default:
+                return meshopt_buildMeshlets(meshlets.data(), meshlet_vertices.data(), meshlet_triangles.data(), indices.data(), indices.size(), vertices.data(), vertices.size() / 3, sizeof(float) * 3, settings.max_vertices, settings.max_triangles, settings.cone_weight);
+        }
+    }
+
+    void append_meshlets(pvp::ModelData& model_out, const pvp::MeshletSettings& settings, std::span<const uint32_t> indices, const std::vector<float>& vertices)
+    {
+        if (indices.empty())
+        {
+            return;
+        }
+
+        std::vector<meshopt_Meshlet> meshlets;
+        std::vector<uint32_t>        meshlet_vertices;
+        std::vector<uint8_t>         meshlet_triangles;
+        const size_t                 meshlet_count = build_meshlets(settings, meshlets, meshlet_vertices, meshlet_triangles, indices, vertices);
+
+        const meshopt_Meshlet& last = meshlets[meshlet_count - 1];
+        meshlet_vertices.resize(last.vertex_offset + last.vertex_count);
+        meshlet_triangles.resize(last.triangle_offset + last.triangle_count * 3);
+        meshlets.resize(meshlet_count);
+
+        const uint32_t vertex_base = static_cast<uint32_t>(model_out.meshlet_vertices.size());
+        const uint32_t triangle_base = static_cast<uint32_t>(model_out.meshlet_triangles.size());
+        model_out.meshlet_vertices.insert(model_out.meshlet_vertices.end(), meshlet_vertices.begin(), meshlet_vertices.end());
+        model_out.meshlet_triangles.insert(model_out.meshlet_triangles.end(), meshlet_triangles.begin(), meshlet_triangles.end());
+
+        model_out.meshlets.reserve(model_out.meshlets.size() + meshlets.size());
+        model_out.meshlet_sphere_bounds.reserve(model_out.meshlet_sphere_bounds.size() + meshlets.size());
+        for (meshopt_Meshlet meshlet : meshlets)
+        {
+            meshlet.vertex_offset += vertex_base;
+            meshlet.triangle_offset += triangle_base;
+            meshopt_optimizeMeshlet(&model_out.meshlet_vertices[meshlet.vertex_offset], &model_out.meshlet_triangles[meshlet.triangle_offset], meshlet.triangle_count, meshlet.vertex_count);
+
+            meshopt_Bounds bounds = meshopt_computeMeshletBounds(
+                &model_out.meshlet_vertices[meshlet.vertex_offset],
+                &model_out.meshlet_triangles[meshlet.triangle_offset],
+                meshlet.triangle_count,
+                vertices.data(),
+                vertices.size() / 3,
+                sizeof(float) * 3);
+            model_out.meshlet_sphere_bounds.push_back(pvp::ConeBounds{
+                .sphere = glm::vec4(bounds.center[0], bounds.center[1], bounds.center[2], bounds.radius),
+                .cone_axis_x = bounds.cone_axis_s8[0],
+                .cone_axis_y = bounds.cone_axis_s8[1],
+                .cone_axis_z = bounds.cone_axis_s8[2],
+                .cone_cutoff = bounds.cone_cutoff_s8,
+            });
+            model_out.meshlets.push_back(meshlet);
+        }
+    }
+
+    void generate_meshlet(pvp::ModelData& model_out, const pvp::MeshletSettings& settings)
+    {
+        const std::vector<float> vertices = vertex_positions(model_out);
+        append_meshlets(model_out, settings, model_out.indices, vertices);
+        model_out.base_meshlet_count = static_cast<uint32_t>(model_out.meshlets.size());
+
+        // Without a hierarchy every meshlet is its own final level
+        model_out.meshlet_lods.reserve(model_out.meshlets.size());
+        for (const pvp::ConeBounds& bounds : model_out.meshlet_sphere_bounds)
+        {
+            model_out.meshlet_lods.push_back(pvp::MeshletLod{
+                .bounds = bounds.sphere,
+                .parent_bounds = bounds.sphere,
+                .error = 0.0f,
+                .parent_error = std::numeric_limits<float>::max(),
+            });
+        }
+
+        // writeOBJ(model_out.meshlet_sphere_bounds, "OutPounts.obj");
+    }
+
+    // Splits the meshlets into spatially close groups by halving them along the longest axis of their lod bounds
+    void partition_meshlets(std::span<uint32_t> meshlets, const std::vector<pvp::MeshletLod>& lods, std::vector<std::span<uint32_t>>& groups_out)
+    {
+        if (meshlets.size() <= meshlet_group_size)
+        {
+            groups_out.push_back(meshlets);
+            return;
+        }
+
+        glm::vec3 min_center{ std::numeric_limits<float>::max() };
+        glm::vec3 max_center{ std::numeric_limits<float>::lowest() };
+        for (uint32_t meshlet : meshlets)
+        {
+            min_center = glm::min(min_center, glm::vec3(lods[meshlet].bounds));
+            max_center = glm::max(max_center, glm::vec3(lods[meshlet].bounds));
+        }
+        const glm::vec3 extent = max_center - min_center;
+        const int       axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+        const size_t half = meshlets.size() / 2;
+        std::ranges::nth_element(meshlets, meshlets.begin() + half, {}, [&](uint32_t meshlet) { return lods[meshlet].bounds[axis]; });
+        partition_meshlets(meshlets.first(half), lods, groups_out);
+        partition_meshlets(meshlets.subspan(half), lods, groups_out);
+    }
+
+    // Builds the meshlet hierarchy: groups neighbouring meshlets, simplifies each group to half its triangles with
+    // the group border locked and clusters the result again. Locked borders keep neighbouring groups watertight so the
+    // task shader can pick every meshlet's level on its own. Errors only grow towards the root so that choice is consistent.
+    void build_meshlet_lods(pvp::ModelData& model_out, const pvp::MeshletSettings& settings)
+    {
+        ZoneScoped;
+        if (model_out.meshlets.empty())
+        {
+            return;
+        }
+
+        const std::vector<float> vertices = vertex_positions(model_out);
+        const float              error_scale = meshopt_simplifyScale(vertices.data(), model_out.vertices.size(), sizeof(float) * 3);
+
+        std::vector<uint32_t> level(model_out.meshlets.size());
+        std::iota(level.begin(), level.end(), 0u);
+
+        std::vector<std::span<uint32_t>> groups;
+        std::vector<uint32_t>            group_indices;
+        std::vector<uint32_t>            simplified;
+        for (uint32_t depth = 0; depth < max_meshlet_lod_levels && level.size() > 1; ++depth)
+        {
+            groups.clear();
+            partition_meshlets(level, model_out.meshlet_lods, groups);
+
+            std::vector<uint32_t> next_level;
+            for (std::span<uint32_t> group : groups)
+            {
+                // A meshlet without neighbours moves up and gets grouped again on the next level
+                if (group.size() == 1)
+                {
+                    next_level.push_back(group[0]);
+                    continue;
+                }
+
+                group_indices.clear();
+                for (uint32_t meshlet_index : group)
+                {
+                    const meshopt_Meshlet& meshlet = model_out.meshlets[meshlet_index];
+                    for (uint32_t i = 0; i < meshlet.triangle_count * 3; ++i)
+                    {
+                        group_indices.push_back(model_out.meshlet_vertices[meshlet.vertex_offset + model_out.meshlet_triangles[meshlet.triangle_offset + i]]);
+                    }
+                }
+
+                float simplify_error{};
+                simplified.resize(group_indices.size());
+                simplified.resize(meshopt_simplify(simplified.data(),
+                                                   group_indices.data(),
+                                                   group_indices.size(),
+                                                   vertices.data(),
+                                                   model_out.vertices.size(),
+                                                   sizeof(float) * 3,
+                                                   group_indices.size() / 6 * 3,
+                                                   std::numeric_limits<float>::max(),
+                                                   meshopt_SimplifyLockBorder,
+                                                   &simplify_error));
+
+                // Mostly locked border, these meshlets stay the coarsest level of their part of the mesh
+                if (simplified.empty() || static_cast<float>(simplified.size()) > static_cast<float>(group_indices.size()) * min_lod_reduction)
+                {
+                    continue;
+                }
+
+                glm::vec3 center{ 0.0f };
+                for (uint32_t meshlet_index : group)
+                {
+                    center += glm::vec3(model_out.meshlet_lods[meshlet_index].bounds);
+                }
+                center /= static_cast<float>(group.size());
+
+                float radius{};
+                float error{};
+                for (uint32_t meshlet_index : group)
+                {
+                    const pvp::MeshletLod& lod = model_out.meshlet_lods[meshlet_index];
+                    radius = std::max(radius, glm::distance(center, glm::vec3(lod.bounds)) + lod.bounds.w);
+                    error = std::max(error, lod.error);
+                }
+                error += simplify_error * error_scale;
+                const glm::vec4 group_bounds{ center, radius };
+
+                for (uint32_t meshlet_index : group)
+                {
+                    model_out.meshlet_lods[meshlet_index].parent_bounds = group_bounds;
+                    model_out.meshlet_lods[meshlet_index].parent_error = error;
+                }
+
+                const uint32_t first_meshlet = static_cast<uint32_t>(model_out.meshlets.size());
+                append_meshlets(model_out, settings, simplified, vertices);
+                for (uint32_t meshlet_index = first_meshlet; meshlet_index < model_out.meshlets.size(); ++meshlet_index)
+                {
+                    model_out.meshlet_lods.push_back(pvp::MeshletLod{
+                        .bounds = group_bounds,
+                        .parent_bounds = group_bounds,
+                        .error = error,
+                        .parent_error = std::numeric_limits<float>::max(),
+                    });
+                    next_level.push_back(meshlet_index);
+                }
+            }
+
+            if (next_level.size() >= level.size())
+            {
+                break;
+            }
+            level = std::move(next_level);
+        }
+    }
+
+    glm::vec2 encode_octahedral(glm::vec3 direction)
+    {
+        const float length = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+        if (length == 0.0f)
+        {
+            return glm::vec2(0.0f);
+        }
+        direction /= length;
+
+        if (direction.z < 0.0f)
+        {
+            return glm::vec2((1.0f - std::abs(direction.y)) * (direction.x >= 0.0f ? 1.0f : -1.0f),
+                             (1.0f - std::abs(direction.x)) * (direction.y >= 0.0f ? 1.0f : -1.0f));
+        }
+        return glm::vec2(direction.x, direction.y);
+    }
+
+    // Bounding box of the vertices and a sphere around them centered on that box
+    void compute_bounds(pvp::ModelData& model)
+    {
+        if (model.vertices.empty())
+        {
+            return;
+        }
+
+        glm::vec3 min_position{ std::numeric_limits<float>::max() };
+        glm::vec3 max_position{ std::numeric_limits<float>::lowest() };
+        for (const pvp::Vertex& vertex : model.vertices)
+        {
+            min_position = glm::min(min_position, vertex.pos);
+            max_position = glm::max(max_position, vertex.pos);
+        }
+
+        const glm::vec3 center = (min_position + max_position) * 0.5f;
+        float           radius{};
+        for (const pvp::Vertex& vertex : model.vertices)
+        {
+            radius = std::max(radius, glm::distance(center, vertex.pos));
+        }
+        model.bounds = glm::vec4(center, radius);
+        model.aabb_min = min_position;
+        model.aabb_max = max_position;
+    }
+
+    // Spreads the low 10 bits of value so two zero bits sit between each of them
+    uint32_t spread_bits(uint32_t value)
+    {
+        value &= 0x3FF;
+        value = (value | value << 16) & 0x030000FF;
+        value = (value | value << 8) & 0x0300F00F;
+        value = (value | value << 4) & 0x030C30C3;
+        value = (value | value << 2) & 0x09249249;
+        return value;
+    }
+
+    // Order of the points along a Morton curve over their bounding box. Equal codes keep their original order.
+    std::vector<uint32_t> morton_order(std::span<const glm::vec3> points)
+    {
+        glm::vec3 min_point{ std::numeric_limits<float>::max() };
+        glm::vec3 max_point{ std::numeric_limits<float>::lowest() };
+        for (const glm::vec3& point : points)
+        {
+            min_point = glm::min(min_point, point);
+            max_point = glm::max(max_point, point);
+        }
+        const glm::vec3 extent = glm::max(max_point - min_point, glm::vec3(std::numeric_limits<float>::min()));
+
+        std::vector<uint32_t> codes(points.size());
+        for (size_t i = 0; i < points.size(); ++i)
+        {
+            const glm::uvec3 cell = glm::uvec3(glm::clamp((points[i] - min_point) / extent, 0.0f, 1.0f) * 1023.0f);
+            codes[i] = spread_bits(cell.x) | spread_bits(cell.y) << 1 | spread_bits(cell.z) << 2;
+        }
+
+        std::vector<uint32_t> order(points.size());
+        std::iota(order.begin(), order.end(), 0u);
+        std::ranges::stable_sort(order, {}, [&](uint32_t i) { return codes[i]; });
+        return order;
+    }
+
+    // Sorts the full detail meshlets and the simplified ones separately so the first base_meshlet_count stay the
+    // full detail level. Vertex and triangle data are rewritten in the new order so neighbouring meshlets share cache lines.
+    void sort_meshlets(pvp::ModelData& model)
+    {
+        ZoneScoped;
+        std::vector<uint32_t> order;
+        order.reserve(model.meshlets.size());
+        auto sort_range = [&](uint32_t begin, uint32_t end) {
+            std::vector<glm::vec3> centers;
+            centers.reserve(end - begin);
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                centers.emplace_back(model.meshlet_sphere_bounds[i].sphere);
+            }
+            for (const uint32_t i : morton_order(centers))
+            {
+                order.push_back(begin + i);
+            }
+        };
+        sort_range(0, model.base_meshlet_count);
+        sort_range(model.base_meshlet_count, static_cast<uint32_t>(model.meshlets.size()));
+
+        std::vector<meshopt_Meshlet> meshlets;
+        std::vector<uint32_t>        meshlet_vertices;
+        std::vector<uint8_t>         meshlet_triangles;
+        std::vector<pvp::ConeBounds> meshlet_sphere_bounds;
+        std::vector<pvp::MeshletLod> meshlet_lods;
+        meshlets.reserve(order.size());
+        meshlet_vertices.reserve(model.meshlet_vertices.size());
+        meshlet_triangles.reserve(model.meshlet_triangles.size());
+        meshlet_sphere_bounds.reserve(order.size());
+        meshlet_lods.reserve(order.size());
+
+        for (const uint32_t i : order)
+        {
+            meshopt_Meshlet meshlet = model.meshlets[i];
+            const auto      vertices = model.meshlet_vertices.begin() + meshlet.vertex_offset;
+            const auto      triangles = model.meshlet_triangles.begin() + meshlet.triangle_offset;
+            meshlet.vertex_offset = static_cast<uint32_t>(meshlet_vertices.size());
+            meshlet.triangle_offset = static_cast<uint32_t>(meshlet_triangles.size());
+            meshlet_vertices.insert(meshlet_vertices.end(), vertices, vertices + meshlet.vertex_count);
+            meshlet_triangles.insert(meshlet_triangles.end(), triangles, triangles + meshlet.triangle_count * 3);
+
+            meshlets.push_back(meshlet);
+            meshlet_sphere_bounds.push_back(model.meshlet_sphere_bounds[i]);
+            meshlet_lods.push_back(model.meshlet_lods[i]);
+        }
+
+        model.meshlets = std::move(meshlets);
+        model.meshlet_vertices = std::move(meshlet_vertices);
+        model.meshlet_triangles = std::move(meshlet_triangles);
+        model.meshlet_sphere_bounds = std::move(meshlet_sphere_bounds);
+        model.meshlet_lods = std::move(meshlet_lods);
+    }
+
+    // Sorts the instances by their world space center, then renumbers the models in the order the instances first use
+    // them. Neighbouring draws and the scene wide buffers built from the models then cover neighbouring space.
+    void sort_instances(pvp::LoadedScene& scene)
+    {
+        ZoneScoped;
+        std::vector<glm::vec3> centers;
+        centers.reserve(scene.instances.size());
+        for (const pvp::ModelInstance& instance : scene.instances)
+        {
+            centers.emplace_back(instance.transform * glm::vec4(glm::vec3(scene.models[instance.model_index].bounds), 1.0f));
+        }
+
+        std::vector<pvp::ModelInstance> instances;
+        instances.reserve(scene.instances.size());
+        for (const uint32_t i : morton_order(centers))
+        {
+            instances.push_back(std::move(scene.instances[i]));
+        }
+
+        constexpr uint32_t    unused = std::numeric_limits<uint32_t>::max();
+        std::vector<uint32_t> new_index(scene.models.size(), unused);
+        std::vector<uint32_t> model_order;
+        model_order.reserve(scene.models.size());
+        for (pvp::ModelInstance& instance : instances)
+        {
+            if (new_index[instance.model_index] == unused)
+            {
+                new_index[instance.model_index] = static_cast<uint32_t>(model_order.size());
+                model_order.push_back(instance.model_index);
+            }
+            instance.model_index = new_index[instance.model_index];
+        }
+        for (uint32_t i = 0; i < scene.models.size(); ++i)
+        {
+            if (new_index[i] == unused)
+            {
+                model_order.push_back(i);
+            }
+        }
+
+        std::vector<pvp::ModelData> models;
+        models.reserve(scene.models.size());
+        for (const uint32_t i : model_order)
+        {
+            models.push_back(std::move(scene.models[i]));
+        }
+        scene.models = std::move(models);
+        scene.instances = std::move(instances);
+    }
+
+    // Discrete levels for the indexed draw path, appended to the indices behind the full detail triangles. Every level is
+    // simplified from full detail and halves the index count of the one before. meshopt_simplifySloppy takes over when
+    // the topology keeps meshopt_simplify far from the target.
+    void generate_index_lods(pvp::ModelData& model)
+    {
+        ZoneScoped;
+        model.index_lods.push_back(pvp::IndexLod{ .index_offset = 0, .index_count = static_cast<uint32_t>(model.indices.size()), .error = 0.0f });
+        if (model.indices.empty())
+        {
+            return;
+        }
+
+        const std::vector<float>    vertices = vertex_positions(model);
+        const float                 error_scale = meshopt_simplifyScale(vertices.data(), model.vertices.size(), sizeof(float) * 3);
+        const std::vector<uint32_t> source = model.indices;
+        std::vector<uint32_t>       simplified;
+        for (uint32_t level = 1; level < pvp::max_index_lods; ++level)
+        {
+            const pvp::IndexLod previous = model.index_lods.back();
+            const size_t        target = static_cast<size_t>(static_cast<float>(previous.index_count) * index_lod_reduction) / 3 * 3;
+
+            float error{};
+            simplified.resize(source.size());
+            simplified.resize(meshopt_simplify(simplified.data(),
+                                               source.data(),
+                                               source.size(),
+                                               vertices.data(),
+                                               model.vertices.size(),
+                                               sizeof(float) * 3,
+                                               target,
+                                               std::numeric_limits<float>::max(),
+                                               0,
+                                               &error));
+            if (simplified.size() > target + target / 2)
+            {
+                simplified.resize(source.size());
+                simplified.resize(meshopt_simplifySloppy(simplified.data(),
+                                                         source.data(),
+                                                         source.size(),
+                                                         vertices.data(),
+                                                         model.vertices.size(),
+                                                         sizeof(float) * 3,
+                                                         target,
+                                                         std::numeric_limits<float>::max(),
+                                                         &error));
+            }
+
+            if (simplified.empty() || static_cast<float>(simplified.size()) > static_cast<float>(previous.index_count) * min_lod_reduction)
+            {
+                break;
+            }
+
+            meshopt_optimizeVertexCache(simplified.data(), simplified.data(), simplified.size(), model.vertices.size());
+            model.index_lods.push_back(pvp::IndexLod{
+                .index_offset = static_cast<uint32_t>(model.indices.size()),
+                .index_count = static_cast<uint32_t>(simplified.size()),
+                .error = std::max(previous.error, error * error_scale),
+            });
+            model.indices.insert(model.indices.end(), simplified.begin(), simplified.end());
+        }
+    }
+
+    // Replaces the float vertices with PackedVertex. Runs after the meshlets are built so their bounds use the exact positions.
+    void pack_vertices(pvp::ModelData& model_out)
+    {
+        glm::vec3 min_position{ std::numeric_limits<float>::max() };
+        glm::vec3 max_position{ std::numeric_limits<float>::lowest() };
+        for (const pvp::Vertex& vertex : model_out.vertices)
+        {
+            min_position = glm::min(min_position, vertex.pos);
+            max_position = glm::max(max_position, vertex.pos);
+        }
+        if (model_out.vertices.empty())
+        {
+            min_position = max_position = glm::vec3(0.0f);
+        }
+
+        model_out.position_offset = min_position;
+        model_out.position_scale = max_position - min_position;
+        const glm::vec3 inverse_scale = 1.0f / glm::max(model_out.position_scale, glm::vec3(std::numeric_limits<float>::min()));
+
+        auto snorm = [](float value) { return static_cast<int16_t>(meshopt_quantizeSnorm(value, 16)); };
+        auto unorm = [](float value) { return static_cast<uint16_t>(meshopt_quantizeUnorm(value, 16)); };
+
+        model_out.packed_vertices.reserve(model_out.vertices.size());
+        for (const pvp::Vertex& vertex : model_out.vertices)
+        {
+            const glm::vec3 position = (vertex.pos - min_position) * inverse_scale;
+            const glm::vec2 normal = encode_octahedral(vertex.normal);
+            const glm::vec2 tangent = encode_octahedral(vertex.tangent);
+
+            model_out.packed_vertices.push_back(pvp::PackedVertex{
+                .pos = { unorm(position.x), unorm(position.y), unorm(position.z), 0 },
+                .normal = { snorm(normal.x), snorm(normal.y) },
+                .tangent = { snorm(tangent.x), snorm(tangent.y) },
+                .uv = { meshopt_quantizeHalf(vertex.uv.x), meshopt_quantizeHalf(vertex.uv.y) },
+            });
+        }
+
+        model_out.vertices.clear();
+        model_out.vertices.shrink_to_fit();
+    }
+
+    VkFormat texture_format(aiTextureType texture_type)
+    {
+        switch (texture_type)
+        {
+            case aiTextureType_DIFFUSE:
+                return VK_FORMAT_R8G8B8A8_SRGB;
+            default:
+                return VK_FORMAT_R8G8B8A8_UNORM;
+        }
+    }
+
+    // RGBA8 mip chain plus the float copies of the two levels generate_mip_chain works on.
+    size_t mip_chain_working_size(int width, int height)
+    {
+        const size_t pixel_count = static_cast<size_t>(width) * height;
+        return pixel_count * 4 * 4 / 3 + pixel_count * sizeof(glm::vec4) * 5 / 4;
+    }
+
+    // Upper bound of the memory a decode will hold before it is copied into TextureData.
+    size_t estimate_decoded_size(const aiScene* scene, const fs::path& folder, const std::string& texture_name)
+    {
+        int tex_width{};
+        int tex_height{};
+        int channels{};
+
+        if (const aiTexture* data = scene->GetEmbeddedTexture(texture_name.c_str()); data != nullptr)
+        {
+            int const index = std::stoi(texture_name.substr(1));
+            if (stbi_info_from_memory(reinterpret_cast<stbi_uc const*>(scene->mTextures[index]->pcData),
+                                      static_cast<int>(scene->mTextures[index]->mWidth),
+                                      &tex_width,
+                                      &tex_height,
+                                      &channels))
+            {
+                return mip_chain_working_size(tex_width, tex_height);
+            }
+            return 0;
+        }
+
+        const fs::path texture_path = folder / texture_name;
+        if (texture_path.extension() == ".dds")
+        {
+            std::error_code error;
+            const uintmax_t file_size = fs::file_size(texture_path, error);
+            return error ? 0 : static_cast<size_t>(file_size);
+        }
+
+        if (stbi_info(texture_path.string().c_str(), &tex_width, &tex_height, &channels))
+        {
+            return mip_chain_working_size(tex_width, tex_height);
+        }
+        return 0;
+    }
+
+    pvp::TextureData decode_texture(const aiScene* scene, const fs::path& folder, const std::string& texture_name, aiTextureType texture_type)
+    {
+        ZoneScopedN("Decode texture");
+        pvp::TextureData loaded_texture{};
+        loaded_texture.name = texture_name;
+
+        auto take_stb_pixels = [&](uint8_t* pixels, int tex_width, int tex_height) {
+            if (!pixels)
+            {
+                spdlog::error("{}", stbi_failure_reason());
+                throw std::runtime_error("failed to load texture image!");
+            }
+
+            const auto pixel_span = std::span(pixels, static_cast<size_t>(tex_height) * tex_width * 4);
+            loaded_texture.width = tex_width;
+            loaded_texture.height = tex_height;
+            loaded_texture.pixels = std::vector(pixel_span.begin(), pixel_span.end());
+            loaded_texture.levels = { pvp::TextureLevel{ .offset = 0, .size = pixel_span.size(), .width = loaded_texture.width, .height = loaded_texture.height } };
+            loaded_texture.format = texture_format(texture_type);
+            stbi_image_free(pixels);
+        };
+
+        int tex_width{};
+        int tex_height{};
+        int channels{};
+
+        if (const aiTexture* data = scene->GetEmbeddedTexture(texture_name.c_str()); data != nullptr)
+        {
+            int const index = std::stoi(texture_name.substr(1));
+            uint8_t*  pixels = stbi_load_from_memory(reinterpret_cast<stbi_uc const*>(scene->mTextures[index]->pcData),
+                                                    static_cast<int>(scene->mTextures[index]->mWidth),
+                                                    &tex_width,
+                                                    &tex_height,
+                                                    &channels,
+                                                    STBI_rgb_alpha);
+            take_stb_pixels(pixels, tex_width, tex_height);
+        }
+        else if (fs::path(texture_name).extension() == ".dds") // Not embeded loading from disk
+        {
+            dds::Image image;
+            if (dds::readFile((folder / texture_name).string(), &image) != dds::Success)
+            {
+                spdlog::error("Can't load dds texture {}", texture_name);
+                throw std::runtime_error("failed to load texture image!");
+            }
+
+            loaded_texture.format = dds::getVulkanFormat(image.format, true);
+            loaded_texture.width = image.width;
+            loaded_texture.height = image.height;
+            // DDS files bring their own mip chain
+            for (uint32_t level = 0; level < image.mipmaps.size(); ++level)
+            {
+                loaded_texture.levels.push_back(pvp::TextureLevel{
+                    .offset = loaded_texture.pixels.size(),
+                    .size = image.mipmaps[level].size(),
+                    .width = std::max(image.width >> level, 1u),
+                    .height = std::max(image.height >> level, 1u),
+                });
+                loaded_texture.pixels.insert(loaded_texture.pixels.end(), image.mipmaps[level].begin(), image.mipmaps[level].end());
+            }
+        }
+        else
+        {
+            uint8_t* pixels = stbi_load((folder / texture_name).string().c_str(), &tex_width, &tex_height, &channels, STBI_rgb_alpha);
+            take_stb_pixels(pixels, tex_width, tex_height);
+        }
+
+        return loaded_texture;
+    }
+
+    bool is_rgba8(VkFormat format)
+    {
+        return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_R8G8B8A8_UNORM;
+    }
+
+    const std::array<float, 256>& srgb_to_linear_table()
+    {
+        static const std::array<float, 256> table = [] {
+            std::array<float, 256> values{};
+            for (size_t i = 0; i < values.size(); ++i)
+            {
+                const float srgb = static_cast<float>(i) / 255.0f;
+                values[i] = srgb <= 0.04045f ? srgb / 12.92f : std::pow((srgb + 0.055f) / 1.055f, 2.4f);
+            }
+            return values;
+        }();
+        return table;
+    }
+
+    uint8_t linear_to_srgb(float linear)
+    {
+        linear = std::clamp(linear, 0.0f, 1.0f);
+        const float srgb = linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+        return static_cast<uint8_t>(srgb * 255.0f + 0.5f);
+    }
+
+    uint8_t linear_to_unorm(float linear)
+    {
+        return static_cast<uint8_t>(std::clamp(linear, 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+
+    // Source texels and weights behind each texel of the next level along one axis. Even sizes average pairs, odd sizes use
+    // three overlapping taps so the last row or column still reaches the next level. A size of 1 is copied.
+    struct MipTaps
+    {
+        std::array<uint32_t, 3> index{};
+        std::array<float, 3>    weight{};
+    };
+
+    std::vector<MipTaps> mip_taps(uint32_t size, uint32_t next_size)
+    {
+        std::vector<MipTaps> taps(next_size);
+        for (uint32_t i = 0; i < next_size; ++i)
+        {
+            if (size == 1)
+            {
+                taps[i] = MipTaps{ { 0, 0, 0 }, { 1.0f, 0.0f, 0.0f } };
+            }
+            else if (size % 2 == 0)
+            {
+                taps[i] = MipTaps{ { i * 2, i * 2 + 1, i * 2 + 1 }, { 0.5f, 0.5f, 0.0f } };
+            }
+            else
+            {
+                const float scale = 1.0f / static_cast<float>(size);
+                taps[i] = MipTaps{ { i * 2, i * 2 + 1, i * 2 + 2 },
+                                   { static_cast<float>(next_size - i) * scale, static_cast<float>(next_size) * scale, static_cast<float>(i + 1) * scale } };
+            }
+        }
+        return taps;
+    }
+
+    // Appends every mip level below level 0 to an RGBA8 texture with a box filter, 2x2 taps or 3 taps along odd sides.
+    // Rows are filtered in parallel.
+    // Color is averaged in linear space for sRGB textures, alpha always linear. Normal maps are renormalized per texel.
+    // Each level is filtered from the float copy of the previous one so rounding does not build up down the chain.
+    void generate_mip_chain(pvp::TextureData& texture, aiTextureType texture_type)
+    {
+        ZoneScoped;
+        const bool                    srgb = texture.format == VK_FORMAT_R8G8B8A8_SRGB;
+        const bool                    normal_map = texture_type == aiTextureType_NORMALS;
+        const std::array<float, 256>& to_linear = srgb_to_linear_table();
+
+        uint32_t width = texture.width;
+        uint32_t height = texture.height;
+
+        std::vector<uint32_t> rows(height);
+        std::iota(rows.begin(), rows.end(), 0u);
+
+        std::vector<glm::vec4> source(static_cast<size_t>(width) * height);
+        std::for_each(std::execution::par, rows.cbegin(), rows.cend(), [&](uint32_t y) {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                const size_t   index = static_cast<size_t>(y) * width + x;
+                const uint8_t* pixel = &texture.pixels[index * 4];
+                source[index] = srgb ?
+                    glm::vec4(to_linear[pixel[0]], to_linear[pixel[1]], to_linear[pixel[2]], static_cast<float>(pixel[3]) / 255.0f) :
+                    glm::vec4(pixel[0], pixel[1], pixel[2], pixel[3]) / 255.0f;
+            }
+        });
+
+        texture.pixels.reserve(texture.pixels.size() * 4 / 3 + 4);
+        std::vector<glm::vec4> destination;
+        while (width > 1 || height > 1)
+        {
+            const uint32_t next_width = std::max(width / 2, 1u);
+            const uint32_t next_height = std::max(height / 2, 1u);
+            const size_t   offset = texture.pixels.size();
+
+            destination.resize(static_cast<size_t>(next_width) * next_height);
+            texture.pixels.resize(offset + destination.size() * 4);
+            rows.resize(next_height);
+            const std::vector<MipTaps> column_taps = mip_taps(width, next_width);
+            const std::vector<MipTaps> row_taps = mip_taps(height, next_height);
+
+            std::for_each(std::execution::par, rows.cbegin(), rows.cend(), [&](uint32_t y) {
+                const MipTaps& row_tap = row_taps[y];
+                for (uint32_t x = 0; x < next_width; ++x)
+                {
+                    const MipTaps& column_tap = column_taps[x];
+                    glm::vec4      value{};
+                    for (size_t row = 0; row < row_tap.index.size(); ++row)
+                    {
+                        for (size_t column = 0; column < column_tap.index.size(); ++column)
+                        {
+                            const float weight = row_tap.weight[row] * column_tap.weight[column];
+                            if (weight > 0.0f)
+                            {
+                                value += source[static_cast<size_t>(row_tap.index[row]) * width + column_tap.index[column]] * weight;
+                            }
+                        }
+                    }
+                    if (normal_map)
+                    {
+                        const glm::vec3 normal = glm::vec3(value) * 2.0f - 1.0f;
+                        const float     length = glm::length(normal);
+                        if (length > 0.0f)
+                        {
+                            value = glm::vec4(normal / length * 0.5f + 0.5f, value.w);
+                        }
+                    }
+
+                    const size_t index = static_cast<size_t>(y) * next_width + x;
+                    destination[index] = value;
+
+                    uint8_t* pixel = &texture.pixels[offset + index * 4];
+                    pixel[0] = srgb ? linear_to_srgb(value.x) : linear_to_unorm(value.x);
+                    pixel[1] = srgb ? linear_to_srgb(value.y) : linear_to_unorm(value.y);
+                    pixel[2] = srgb ? linear_to_srgb(value.z) : linear_to_unorm(value.z);
+                    pixel[3] = linear_to_unorm(value.w);
+                }
+            });
+
+            texture.levels.push_back(pvp::TextureLevel{ .offset = offset, .size = destination.size() * 4, .width = next_width, .height = next_height });
+            std::swap(source, destination);
+            width = next_width;
+            height = next_height;
+        }
+    }
+
+    // Encodes every level of an RGBA8 texture into 4x4 blocks. Rows of blocks are encoded in parallel.
+    // Albedo goes to BC7, normals to BC5 (xy, z is rebuilt in the shader) and metal-roughness to BC5 of green and blue
+    // with a swizzle putting them back into .g and .b. Edge blocks repeat the last row and column.
+    void compress_texture(pvp::TextureData& texture, aiTextureType texture_type)
+    {
+        ZoneScoped;
+        static std::once_flag init_flag;
+        std::call_once(init_flag, [] {
+            rgbcx::init();
+            bc7enc_compress_block_init();
+        });
+
+        enum class BlockFormat
+        {
+            bc5,
+            bc7
+        };
+
+        BlockFormat        block_format{ BlockFormat::bc7 };
+        VkFormat           format{ texture_format(texture_type) == VK_FORMAT_R8G8B8A8_SRGB ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK };
+        uint32_t           channel_0{};
+        uint32_t           channel_1{ 1 };
+        VkComponentMapping swizzle{};
+        switch (texture_type)
+        {
+            case aiTextureType_NORMALS:
+                block_format = BlockFormat::bc5;
+                format = VK_FORMAT_BC5_UNORM_BLOCK;
+                break;
+            case aiTextureType_METALNESS:
+                block_format = BlockFormat::bc5;
+                format = VK_FORMAT_BC5_UNORM_BLOCK;
+                channel_0 = 1;
+                channel_1 = 2;
+                swizzle = { VK_COMPONENT_SWIZZLE_ZERO, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_ONE };
+                break;
+            default:
+                break;
+        }
+
+        bc7enc_compress_block_params bc7_params;
+        bc7enc_compress_block_params_init(&bc7_params);
+        if (format != VK_FORMAT_BC7_SRGB_BLOCK)
+        {
+            bc7enc_compress_block_params_init_linear_weights(&bc7_params);
+        }
+
+        constexpr size_t block_bytes = 16; // BC5 and BC7 are both 16 bytes per block
+
+        std::vector<uint8_t>           blocks;
+        std::vector<pvp::TextureLevel> levels;
+        for (const pvp::TextureLevel& level : texture.levels)
+        {
+            const uint32_t blocks_x = (level.width + 3) / 4;
+            const uint32_t blocks_y = (level.height + 3) / 4;
+            const size_t   offset = blocks.size();
+            const uint8_t* level_pixels = &texture.pixels[level.offset];
+
+            blocks.resize(offset + static_cast<size_t>(blocks_x) * blocks_y * block_bytes);
+            std::vector<uint32_t> rows(blocks_y);
+            std::iota(rows.begin(), rows.end(), 0u);
+            std::for_each(std::execution::par, rows.cbegin(), rows.cend(), [&](uint32_t block_y) {
+                std::array<uint8_t, 4 * 4 * 4> block_pixels;
+                for (uint32_t block_x = 0; block_x < blocks_x; ++block_x)
+                {
+                    for (uint32_t y = 0; y < 4; ++y)
+                    {
+                        const uint32_t source_y = std::min(block_y * 4 + y, level.height - 1);
+                        for (uint32_t x = 0; x < 4; ++x)
+                        {
+                            const uint32_t source_x = std::min(block_x * 4 + x, level.width - 1);
+                            std::memcpy(&block_pixels[(y * 4 + x) * 4], &level_pixels[(static_cast<size_t>(source_y) * level.width + source_x) * 4], 4);
+                        }
+                    }
+
+                    uint8_t* block = &blocks[offset + (static_cast<size_t>(block_y) * blocks_x + block_x) * block_bytes];
+                    if (block_format == BlockFormat::bc5)
+                    {
+                        rgbcx::encode_bc5(block, block_pixels.data(), channel_0, channel_1);
+                    }
+                    else
+                    {
+                        bc7enc_compress_block(block, block_pixels.data(), &bc7_params);
+                    }
+                }
+            });
+            levels.push_back(pvp::TextureLevel{ .offset = offset, .size = blocks.size() - offset, .width = level.width, .height = level.height });
+        }
+
+        texture.pixels = std::move(blocks);
+        texture.levels = std::move(levels);
+        texture.format = format;
+        texture.swizzle = swizzle;
+    }
+
+    // Blocks decoders while the decoded bytes that are still alive would go over the budget.
+    // A single texture bigger than the budget is let through once nothing else is in flight.
+    class DecodeBudget final
+    {
+    public:
+        explicit DecodeBudget(size_t max_bytes)
+            : m_max_bytes{ max_bytes }
+        {
+        }
+
+        void acquire(size_t bytes)
+        {
+            std::unique_lock lock(m_mutex);
+            m_condition.wait(lock, [&] { return m_in_flight == 0 || m_in_flight + bytes <= m_max_bytes; });
+            m_in_flight += bytes;
+        }
+
+        void release(size_t bytes)
+        {
+            {
+                std::lock_guard lock(m_mutex);
+                m_in_flight -= bytes;
+            }
+            m_condition.notify_all();
+        }
+
+    private:
+        std::mutex              m_mutex;
+        std::condition_variable m_condition;
+        size_t                  m_in_flight{};
+        size_t                  m_max_bytes{};
+    };
+
+    std::vector<pvp::TextureData> decode_textures(const aiScene*                                            scene,
+                                                  const fs::path&                                           folder,
+                                                  const std::vector<std::pair<std::string, aiTextureType>>& texture_jobs,
+                                                  pvp::TextureCompression                                   compression)
+    {
+        ZoneScoped;
+        constexpr size_t max_decode_bytes_in_flight = 512ull * 1024ull * 1024ull;
+
+        std::vector<pvp::TextureData> textures(texture_jobs.size());
+        DecodeBudget                  budget{ max_decode_bytes_in_flight };
+        std::atomic<size_t>           next_job{};
+        std::exception_ptr            first_error;
+        std::mutex                    error_mutex;
+
+        auto worker = [&] {
+            for (size_t job = next_job++; job < texture_jobs.size(); job = next_job++)
+            {
+                const auto& [texture_name, texture_type] = texture_jobs[job];
+                const size_t decoded_size = estimate_decoded_size(scene, folder, texture_name);
+
+                budget.acquire(decoded_size);
+                try
+                {
+                    textures[job] = decode_texture(scene, folder, texture_name, texture_type);
+                    if (is_rgba8(textures[job].format))
+                    {
+                        generate_mip_chain(textures[job], texture_type);
+                        if (compression == pvp::TextureCompression::bcn)
+                        {
+                            compress_texture(textures[job], texture_type);
+                        }
+                    }
+                }
+                catch (...)
+                {
+                    std::lock_guard lock(error_mutex);
+                    if (!first_error)
+                        first_error = std::current_exception();
+                }
+                budget.release(decoded_size);
+            }
+        };
+
+        const size_t thread_count = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, std::max<size_t>(texture_jobs.size(), 1));
+        std::vector<std::thread> workers;
+        workers.reserve(thread_count);
+        for (size_t i = 0; i < thread_count; ++i)
+        {
+            workers.emplace_back(worker);
+        }
+        for (std::thread& thread : workers)
+        {
+            thread.join();
+        }
+
+        if (first_error)
+            std::rethrow_exception(first_error);
+
+        return textures;
+    }
+
+    uint64_t hash_texture(const pvp::TextureData& texture)
+    {
+        const std::array<uint64_t, 4> header{ static_cast<uint64_t>(texture.format), texture.width, texture.height, texture.levels.size() };
+        XXH3_state_t* const           state = XXH3_createState();
+        XXH3_64bits_reset(state);
+        XXH3_64bits_update(state, header.data(), sizeof(header));
+        XXH3_64bits_update(state, &texture.swizzle, sizeof(texture.swizzle));
+        XXH3_64bits_update(state, texture.pixels.data(), texture.pixels.size());
+        const uint64_t hash = XXH3_64bits_digest(state);
+        XXH3_freeState(state);
+        return hash;
+    }
+
+    bool same_texture(const pvp::TextureData& lhs, const pvp::TextureData& rhs)
+    {
+        return lhs.format == rhs.format && lhs.width == rhs.width && lhs.height == rhs.height && lhs.levels.size() == rhs.levels.size() &&
+            std::memcmp(&lhs.swizzle, &rhs.swizzle, sizeof(VkComponentMapping)) == 0 && lhs.pixels == rhs.pixels;
+    }
+
+    // Collapses textures with the same final payload into the first one and points the instances that used a copy at it.
+    // Embedded images and exporters often store one image under several names, each would be its own StaticImage otherwise.
+    void deduplicate_textures(pvp::LoadedScene& scene)
+    {
+        ZoneScoped;
+        std::vector<uint64_t> hashes(scene.textures.size());
+        std::vector<size_t>   texture_indices(scene.textures.size());
+        std::iota(texture_indices.begin(), texture_indices.end(), size_t{ 0 });
+        std::for_each(std::execution::par, texture_indices.cbegin(), texture_indices.cend(), [&](size_t texture_index) {
+            hashes[texture_index] = hash_texture(scene.textures[texture_index]);
+        });
+
+        std::unordered_multimap<uint64_t, size_t>    unique_textures;
+        std::unordered_map<std::string, std::string> renamed; // Name of a removed copy -> name of the kept texture
+        std::vector<pvp::TextureData>                kept;
+        kept.reserve(scene.textures.size());
+        for (size_t texture_index = 0; texture_index < scene.textures.size(); ++texture_index)
+        {
+            pvp::TextureData& texture = scene.textures[texture_index];
+            const auto [first, last] = unique_textures.equal_range(hashes[texture_index]);
+            const auto duplicate = std::find_if(first, last, [&](const auto& entry) { return same_texture(kept[entry.second], texture); });
+            if (duplicate != last)
+            {
+                renamed.emplace(texture.name, kept[duplicate->second].name);
+                continue;
+            }
+            unique_textures.emplace(hashes[texture_index], kept.size());
+            kept.push_back(std::move(texture));
+        }
+
+        if (renamed.empty())
+        {
+            return;
+        }
+        spdlog::info("Removed {} duplicate textures", renamed.size());
+        scene.textures = std::move(kept);
+
+        auto remap = [&](std::string& path) {
+            if (const auto found = renamed.find(path); found != renamed.end())
+            {
+                path = found->second;
+            }
+        };
+        for (pvp::ModelInstance& instance : scene.instances)
+        {
+            remap(instance.diffuse_path);
+            remap(instance.metallic_path);
+            remap(instance.normal_path);
+        }
+    }
+
+    // One cache slot per scene path and import settings. Whether the slot is still valid is decided by its dependency table.
+    std::string cached_string(const std::filesystem::path& path, const pvp::ImportSettings& settings)
+    {
+        const std::string absolute_path = fs::absolute(path).generic_string();
+        return std::format("{}-{:016x}", path.filename().string(), XXH3_64bits_withSeed(absolute_path.data(), absolute_path.size(), import_settings_hash(settings)));
+    }
+
+    bool has_cache(const std::filesystem::path& path, const pvp::ImportSettings& settings)
+    {
+        if (!fs::is_directory("cache"))
+        {
+            fs::create_directory("cache");
+        }
+
+        std::string check_name = cached_string(path, settings);
 
-        // std::vector<uint8_t> meshlet_triangles_u8;
+        return fs::exists(fs::path("cache") / check_name);
+    }
+
+    // Cache layout: CacheHeader, then every array as its own section aligned to cache_section_alignment,
+    // followed by the model, texture and dependency tables. Tables only store offsets so the file can be mapped and used in place.
+    constexpr uint32_t cache_magic = 0x43505650; // "PVPC"
+    constexpr uint32_t cache_version = 13;
+    constexpr uint64_t cache_section_alignment = 64;
+
+    constexpr int      cache_zstd_level = ZSTD_CLEVEL_DEFAULT;
 
-        const size_t max_mesh_lets = meshopt_buildMeshletsBound(model_out.indices.size(), max_vertices, max_triangles);
-        model_out.meshlets.resize(max_mesh_lets);
-        model_out.meshlet_vertices.resize(max_mesh_lets * max_vertices);
-        model_out.meshlet_triangles.resize(max_mesh_lets * max_triangles * 3);
+    enum class CacheCodec : uint32_t
+    {
+        none = 0,
+        meshopt_vertex,
+        meshopt_index,
+        meshopt_index_sequence
+    };
 
-        std::vector<float> vertices;
-        vertices.reserve(model_out.vertices.size() * 3);
-        for (pvp::Vertex& vertex : model_out.vertices)
+    struct CacheSection
+    {
+        uint64_t   offset;
+        uint64_t   size;        // Decoded size
+        uint64_t   stored_size; // Size in the file
+        CacheCodec codec;
+        uint32_t   element_size;
+        uint32_t   zstd; // The stored bytes are a zstd frame around the codec output
+        uint32_t   padding;
+    };
+
+    struct CacheHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t model_count;
+        uint32_t texture_count; // Excluding the cube map which is always the last texture entry
+        uint64_t model_table_offset;
+        uint64_t texture_table_offset;
+        uint64_t file_size;
+
+        uint64_t settings_hash;
+        uint64_t content_hash; // Combined hash of all dependency content hashes and settings_hash
+        uint64_t dependency_table_offset;
+        uint32_t dependency_count;
+        uint32_t vertex_format;
+        uint64_t instance_table_offset;
+        uint32_t instance_count;
+        uint32_t padding;
+    };
+
+    struct CacheModelEntry
+    {
+        CacheSection vertices;
+        CacheSection indices;
+        CacheSection meshlets;
+        CacheSection meshlet_vertices;
+        CacheSection meshlet_triangles;
+        CacheSection meshlet_sphere_bounds;
+        CacheSection meshlet_lods;
+        CacheSection index_lods;
+        CacheSection packed_vertices;
+        glm::vec3    position_offset;
+        glm::vec3    position_scale;
+        uint32_t     optimization_passes;
+        uint32_t     base_meshlet_count;
+        glm::vec4    bounds;
+        glm::vec3    aabb_min;
+        glm::vec3    aabb_max;
+    };
+
+    struct CacheInstanceEntry
+    {
+        glm::mat4x4  transform;
+        CacheSection diffuse_path;
+        CacheSection metallic_path;
+        CacheSection normal_path;
+        uint32_t     model_index;
+        uint32_t     decompress_normals;
+    };
+
+    struct CacheTextureEntry
+    {
+        CacheSection name;
+        CacheSection pixels;
+        uint32_t     width;
+        uint32_t     height;
+        CacheSection       levels;
+        VkFormat           format;
+        VkComponentMapping swizzle;
+    };
+
+    // Size and write time are only used as a fast path. When they differ the content hash decides.
+    struct CacheDependencyEntry
+    {
+        CacheSection path;
+        uint64_t     file_size;
+        int64_t      write_time;
+        uint64_t     content_hash;
+    };
+
+    // A section ready to be written. encoded is empty when the data is stored as is.
+    struct PreparedSection
+    {
+        std::span<const std::byte> data;
+        std::vector<uint8_t>       encoded;
+        CacheCodec                 codec{ CacheCodec::none };
+        uint32_t                   element_size{};
+        bool                       zstd{};
+    };
+
+    template<typename T>
+    PreparedSection prepare_section(std::span<const T> data, CacheCodec codec, bool zstd, size_t vertex_count = 0)
+    {
+        PreparedSection prepared{ .data = std::as_bytes(data), .codec = codec, .element_size = sizeof(T), .zstd = zstd };
+        const auto*     indices = reinterpret_cast<const unsigned int*>(data.data());
+        switch (codec)
         {
-            vertices.push_back(vertex.pos.x);
-            vertices.push_back(vertex.pos.y);
-            vertices.push_back(vertex.pos.z);
+            case CacheCodec::none:
+                break;
+            case CacheCodec::meshopt_vertex:
+                prepared.encoded.resize(meshopt_encodeVertexBufferBound(data.size(), sizeof(T)));
+                prepared.encoded.resize(meshopt_encodeVertexBuffer(prepared.encoded.data(), prepared.encoded.size(), data.data(), data.size(), sizeof(T)));
+                break;
+            case CacheCodec::meshopt_index:
+                prepared.encoded.resize(meshopt_encodeIndexBufferBound(data.size(), vertex_count));
+                prepared.encoded.resize(meshopt_encodeIndexBuffer(prepared.encoded.data(), prepared.encoded.size(), indices, data.size()));
+                break;
+            case CacheCodec::meshopt_index_sequence:
+                prepared.encoded.resize(meshopt_encodeIndexSequenceBound(data.size(), vertex_count));
+                prepared.encoded.resize(meshopt_encodeIndexSequence(prepared.encoded.data(), prepared.encoded.size(), indices, data.size()));
+                break;
         }
 
-        const size_t meshlet_count = meshopt_buildMeshlets(
-            model_out.meshlets.data(),
-            model_out.meshlet_vertices.data(),
-            model_out.meshlet_triangles.data(),
-            model_out.indices.data(),
-            model_out.indices.size(),
-            vertices.data(),
-            vertices.size(),
-            sizeof(float) * 3,
-            max_vertices,
-            max_triangles,
-            cone_weight);
+        if (zstd)
+        {
+            const std::span<const uint8_t> input = prepared.encoded.empty() ?
+                std::span(reinterpret_cast<const uint8_t*>(prepared.data.data()), prepared.data.size()) :
+                std::span<const uint8_t>(prepared.encoded);
 
-        const meshopt_Meshlet& last = model_out.meshlets[meshlet_count - 1];
-        model_out.meshlet_vertices.resize(last.vertex_offset + last.vertex_count);
-        model_out.meshlet_triangles.resize(last.triangle_offset + last.triangle_count * 3);
-        model_out.meshlets.resize(meshlet_count);
+            std::vector<uint8_t> compressed(ZSTD_compressBound(input.size()));
+            const size_t         compressed_size = ZSTD_compress(compressed.data(), compressed.size(), input.data(), input.size(), cache_zstd_level);
+            if (!ZSTD_isError(compressed_size) && compressed_size < input.size())
+            {
+                compressed.resize(compressed_size);
+                prepared.encoded = std::move(compressed);
+            }
+            else
+            {
+                prepared.zstd = false;
+            }
+        }
 
-        for (const meshopt_Meshlet& meshlet : model_out.meshlets)
+        // Encoding failed or did not pay off
+        if (prepared.encoded.empty() || prepared.encoded.size() >= prepared.data.size())
         {
-            meshopt_optimizeMeshlet(&model_out.meshlet_vertices[meshlet.vertex_offset], &model_out.meshlet_triangles[meshlet.triangle_offset], meshlet.triangle_count, meshlet.vertex_count);
+            prepared.encoded.clear();
+            prepared.codec = CacheCodec::none;
+            prepared.zstd = false;
         }
+        return prepared;
+    }
 
-        // writeOBJMeshLets("Meshlets.obj", model_out.meshlets, model_out.meshlet_vertices, meshlet_triangles_u8, vertices, meshlet_count);
-
-        // for (auto& meshlet : model_out.meshlets)
-        // {
-        // Save triangle offset for current meshlet
-        // uint32_t triangle_offset = static_cast<uint32_t>(model_out.meshlet_triangles.size());
-
-        // Repack to uint32_t
-        // for (uint32_t i = 0; i < meshlet.triangle_count; ++i)
-        // {
-        // uint32_t i0 = 3 * i + 0 + meshlet.triangle_offset;
-        // uint32_t i1 = 3 * i + 1 + meshlet.triangle_offset;
-        // uint32_t i2 = 3 * i + 2 + meshlet.triangle_offset;
-        //
-        // uint8_t  vertex_id0 = meshlet_triangles_u8[i0];
-        // uint8_t  vertex_id1 = meshlet_triangles_u8[i1];
-        // uint8_t  vertex_id2 = meshlet_triangles_u8[i2];
-        // uint32_t packed = ((static_cast<uint32_t>(vertex_id0) & 0xFF) << 0) |
-        //     ((static_cast<uint32_t>(vertex_id1) & 0xFF) << 8) |
-        //     ((static_cast<uint32_t>(vertex_id2) & 0xFF) << 16);
-        // model_out.meshlet_triangles.push_back(packed);
-        // model_out.meshlet_triangles
-        // }
-
-        // Update triangle offset for current meshlet
-        // meshlet.triangle_offset = triangle_offset;
-        // }
-
-        model_out.meshlet_sphere_bounds.reserve(model_out.meshlets.size());
-        for (const auto& meshlet : model_out.meshlets)
+    bool decode_section(const CacheSection& section, std::span<const uint8_t> stored, std::span<uint8_t> out)
+    {
+        std::vector<uint8_t> inflated;
+        if (section.zstd != 0)
         {
-            meshopt_Bounds bounds = meshopt_computeMeshletBounds(
-                &model_out.meshlet_vertices[meshlet.vertex_offset],
-                &model_out.meshlet_triangles[meshlet.triangle_offset],
-                meshlet.triangle_count,
-                vertices.data(),
-                vertices.size(),
-                sizeof(float) * 3);
-            model_out.meshlet_sphere_bounds.emplace_back(
-                glm::vec4(bounds.center[0], bounds.center[1], bounds.center[2], bounds.radius),
-                glm::vec4(bounds.cone_axis[0],
-                          bounds.cone_axis[1],
-                          bounds.cone_axis[2],
-                          bounds.cone_cutoff));
+            if (section.codec == CacheCodec::none)
+            {
+                return ZSTD_decompress(out.data(), out.size(), stored.data(), stored.size()) == out.size();
+            }
+
+            const unsigned long long inflated_size = ZSTD_getFrameContentSize(stored.data(), stored.size());
+            if (inflated_size == ZSTD_CONTENTSIZE_ERROR || inflated_size == ZSTD_CONTENTSIZE_UNKNOWN)
+            {
+                return false;
+            }
+            inflated.resize(inflated_size);
+            if (ZSTD_decompress(inflated.data(), inflated.size(), stored.data(), stored.size()) != inflated.size())
+            {
+                return false;
+            }
+            stored = inflated;
         }
 
-        // writeOBJ(model_out.meshlet_sphere_bounds, "OutPounts.obj");
+        if (section.element_size == 0 || out.size() % section.element_size != 0)
+        {
+            return false;
+        }
+        const size_t count = out.size() / section.element_size;
+        switch (section.codec)
+        {
+            case CacheCodec::none:
+                return false;
+            case CacheCodec::meshopt_vertex:
+                return meshopt_decodeVertexBuffer(out.data(), count, section.element_size, stored.data(), stored.size()) == 0;
+            case CacheCodec::meshopt_index:
+                return meshopt_decodeIndexBuffer(out.data(), count, section.element_size, stored.data(), stored.size()) == 0;
+            case CacheCodec::meshopt_index_sequence:
+                return meshopt_decodeIndexSequence(out.data(), count, section.element_size, stored.data(), stored.size()) == 0;
+        }
+        return false;
     }
 
-    std::string cached_string(const std::filesystem::path& path)
+    struct PreparedModel
     {
-        return std::format("{}, {:%Y%m%d%H%M}, {}", path.filename().string(), std::filesystem::last_write_time(path), std::filesystem::file_size(path));
+        PreparedSection vertices;
+        PreparedSection packed_vertices;
+        PreparedSection indices;
+        PreparedSection meshlets;
+        PreparedSection meshlet_vertices;
+        PreparedSection meshlet_triangles;
+        PreparedSection meshlet_sphere_bounds;
+        PreparedSection meshlet_lods;
+        PreparedSection index_lods;
+    };
+
+    PreparedModel prepare_model(const pvp::ModelData& model, pvp::CacheCompression compression)
+    {
+        ZoneScoped;
+        const bool       meshopt = compression != pvp::CacheCompression::none;
+        const bool       zstd = compression == pvp::CacheCompression::meshopt_zstd;
+        const CacheCodec vertex_codec = meshopt ? CacheCodec::meshopt_vertex : CacheCodec::none;
+        const size_t     vertex_count = std::max(model.vertices.size(), model.packed_vertices.size());
+
+        // The meshlet triangles are bytes which the vertex codec can't take, they only get zstd
+        return PreparedModel{
+            .vertices = prepare_section(std::span(model.vertices), vertex_codec, zstd),
+            .packed_vertices = prepare_section(std::span(model.packed_vertices), vertex_codec, zstd),
+            .indices = prepare_section(std::span(model.indices), meshopt ? CacheCodec::meshopt_index : CacheCodec::none, zstd, vertex_count),
+            .meshlets = prepare_section(std::span(model.meshlets), vertex_codec, zstd),
+            .meshlet_vertices = prepare_section(std::span(model.meshlet_vertices), meshopt ? CacheCodec::meshopt_index_sequence : CacheCodec::none, zstd, vertex_count),
+            .meshlet_triangles = prepare_section(std::span(model.meshlet_triangles), CacheCodec::none, zstd),
+            .meshlet_sphere_bounds = prepare_section(std::span(model.meshlet_sphere_bounds), vertex_codec, zstd),
+            .meshlet_lods = prepare_section(std::span(model.meshlet_lods), vertex_codec, zstd),
+            .index_lods = prepare_section(std::span(model.index_lods), vertex_codec, zstd),
+        };
     }
 
-    bool has_cache(const std::filesystem::path& path)
+    fs::path cache_path(const std::filesystem::path& path, const pvp::ImportSettings& settings)
     {
-        if (!fs::is_directory("cache"))
+        return fs::path("cache") / cached_string(path, settings);
+    }
+
+    bool save_cache(const std::filesystem::path& path, const pvp::ImportSettings& settings, const pvp::LoadedScene& scene)
+    {
+        ZoneScoped;
+        const fs::path final_path = cache_path(path, settings);
+        fs::path       temp_path = final_path;
+        temp_path += ".tmp";
+
+        std::error_code error;
+        fs::create_directories(final_path.parent_path(), error);
+
         {
-            fs::create_directory("cache");
-        }
+            std::ofstream out_stream(temp_path, std::ios::binary);
+            if (!out_stream)
+            {
+                spdlog::error("Can't open scene cache {}", temp_path.string());
+                return false;
+            }
+
+            CacheHeader header{ .magic = cache_magic, .version = cache_version, .vertex_format = static_cast<uint32_t>(scene.vertex_format) };
+            write_pod(out_stream, header);
+
+            auto section = [&](auto data) {
+                return CacheSection{ .offset = write_aligned(out_stream, data, cache_section_alignment), .size = data.size_bytes(), .stored_size = data.size_bytes() };
+            };
+            auto string_section = [&](const std::string& str) {
+                return section(std::span(str.data(), str.size()));
+            };
+            auto prepared_section = [&](const PreparedSection& prepared) {
+                if (prepared.encoded.empty())
+                {
+                    return section(prepared.data);
+                }
+                return CacheSection{
+                    .offset = write_aligned(out_stream, std::span(prepared.encoded), cache_section_alignment),
+                    .size = prepared.data.size_bytes(),
+                    .stored_size = prepared.encoded.size(),
+                    .codec = prepared.codec,
+                    .element_size = prepared.element_size,
+                    .zstd = prepared.zstd,
+                };
+            };
+
+            // Encoding is the slow part, do it on all cores before writing serially
+            std::vector<PreparedModel>   prepared_models(scene.models.size());
+            std::vector<PreparedSection> prepared_pixels(scene.textures.size() + 1);
+            std::vector<size_t>          prepare_jobs(prepared_models.size() + prepared_pixels.size());
+            std::iota(prepare_jobs.begin(), prepare_jobs.end(), size_t{ 0 });
+            std::for_each(std::execution::par, prepare_jobs.cbegin(), prepare_jobs.cend(), [&](size_t job) {
+                if (job < prepared_models.size())
+                {
+                    prepared_models[job] = prepare_model(scene.models[job], settings.cache_compression);
+                    return;
+                }
+                const size_t             texture_index = job - prepared_models.size();
+                const pvp::TextureData& texture = texture_index < scene.textures.size() ? scene.textures[texture_index] : scene.cube_map;
+                prepared_pixels[texture_index] = prepare_section(std::span(texture.pixels), CacheCodec::none, settings.cache_compression == pvp::CacheCompression::meshopt_zstd);
+            });
+
+            std::vector<CacheModelEntry> model_table;
+            model_table.reserve(scene.models.size());
+            for (size_t i = 0; i < scene.models.size(); ++i)
+            {
+                const pvp::ModelData& model = scene.models[i];
+                const PreparedModel&  prepared = prepared_models[i];
+                model_table.push_back(CacheModelEntry{
+                    .vertices = prepared_section(prepared.vertices),
+                    .indices = prepared_section(prepared.indices),
+                    .meshlets = prepared_section(prepared.meshlets),
+                    .meshlet_vertices = prepared_section(prepared.meshlet_vertices),
+                    .meshlet_triangles = prepared_section(prepared.meshlet_triangles),
+                    .meshlet_sphere_bounds = prepared_section(prepared.meshlet_sphere_bounds),
+                    .meshlet_lods = prepared_section(prepared.meshlet_lods),
+                    .index_lods = prepared_section(prepared.index_lods),
+                    .packed_vertices = prepared_section(prepared.packed_vertices),
+                    .position_offset = model.position_offset,
+                    .position_scale = model.position_scale,
+                    .optimization_passes = static_cast<uint32_t>(model.optimization_passes),
+                    .base_meshlet_count = model.base_meshlet_count,
+                    .bounds = model.bounds,
+                    .aabb_min = model.aabb_min,
+                    .aabb_max = model.aabb_max,
+                });
+            }
 
-        std::string check_name = cached_string(path);
+            std::vector<CacheInstanceEntry> instance_table;
+            instance_table.reserve(scene.instances.size());
+            for (const pvp::ModelInstance& instance : scene.instances)
+            {
+                instance_table.push_back(CacheInstanceEntry{
+                    .transform = instance.transform,
+                    .diffuse_path = string_section(instance.diffuse_path),
+                    .metallic_path = string_section(instance.metallic_path),
+                    .normal_path = string_section(instance.normal_path),
+                    .model_index = instance.model_index,
+                    .decompress_normals = instance.decompress_normals,
+                });
+            }
 
-        return fs::exists(fs::path("cache") / check_name);
+            std::vector<CacheTextureEntry> texture_table;
+            texture_table.reserve(scene.textures.size() + 1);
+            auto save_texture = [&](const pvp::TextureData& texture, const PreparedSection& pixels) {
+                texture_table.push_back(CacheTextureEntry{
+                    .name = string_section(texture.name),
+                    .pixels = prepared_section(pixels),
+                    .width = texture.width,
+                    .height = texture.height,
+                    .levels = section(std::span(texture.levels)),
+                    .format = texture.format,
+                    .swizzle = texture.swizzle,
+                });
+            };
+            for (size_t i = 0; i < scene.textures.size(); ++i)
+            {
+                save_texture(scene.textures[i], prepared_pixels[i]);
+            }
+            save_texture(scene.cube_map, prepared_pixels.back());
+
+            std::vector<CacheDependencyEntry> dependency_table(scene.dependencies.size());
+            std::vector<size_t>               dependency_indices(scene.dependencies.size());
+            std::iota(dependency_indices.begin(), dependency_indices.end(), size_t{ 0 });
+            std::for_each(std::execution::par, dependency_indices.cbegin(), dependency_indices.cend(), [&](size_t i) {
+                std::error_code error;
+                const fs::path  dependency = scene.dependencies[i];
+                dependency_table[i].file_size = fs::file_size(dependency, error);
+                dependency_table[i].write_time = write_time(dependency);
+                dependency_table[i].content_hash = hash_file(dependency);
+            });
+
+            std::vector<uint64_t> combined_hashes{ import_settings_hash(settings) };
+            for (size_t i = 0; i < dependency_table.size(); ++i)
+            {
+                dependency_table[i].path = string_section(scene.dependencies[i]);
+                combined_hashes.push_back(dependency_table[i].content_hash);
+            }
+
+            header.settings_hash = import_settings_hash(settings);
+            header.content_hash = XXH3_64bits(combined_hashes.data(), combined_hashes.size() * sizeof(uint64_t));
+            header.dependency_count = static_cast<uint32_t>(dependency_table.size());
+            header.model_count = static_cast<uint32_t>(model_table.size());
+            header.instance_count = static_cast<uint32_t>(instance_table.size());
+            header.texture_count = static_cast<uint32_t>(scene.textures.size());
+            header.model_table_offset = write_aligned(out_stream, std::span<const CacheModelEntry>(model_table), cache_section_alignment);
+            header.instance_table_offset = write_aligned(out_stream, std::span<const CacheInstanceEntry>(instance_table), cache_section_alignment);
+            header.texture_table_offset = write_aligned(out_stream, std::span<const CacheTextureEntry>(texture_table), cache_section_alignment);
+            header.dependency_table_offset = write_aligned(out_stream, std::span<const CacheDependencyEntry>(dependency_table), cache_section_alignment);
+            header.file_size = static_cast<uint64_t>(out_stream.tellp());
+
+            out_stream.seekp(0);
+            write_pod(out_stream, header);
+            if (!out_stream)
+            {
+                spdlog::error("Can't write scene cache {}", temp_path.string());
+                return false;
+            }
+        }
+
+        fs::rename(temp_path, final_path, error);
+        if (error)
+        {
+            spdlog::error("Can't write scene cache {}: {}", final_path.string(), error.message());
+            return false;
+        }
+        return true;
     }
 
-    void save_cache(const std::filesystem::path& path, const pvp::LoadedScene& scene)
+    // Checks the dependency table without mapping the whole cache. Dependencies whose size and write time still
+    // match are trusted, the others are hashed again. Entries that only got touched are updated in place so the
+    // next check takes the fast path again. Read only, so caches in read only locations or still mapped by a loaded
+    // scene validate too, the update is skipped when the file can't be written.
+    bool dependencies_unchanged(const std::filesystem::path& path, const pvp::ImportSettings& settings)
     {
-        std::ofstream out_stream(fs::path("cache") / cached_string(path), std::ios::binary);
+        ZoneScoped;
+        std::ifstream cache_stream(cache_path(path, settings), std::ios::binary);
+        if (!cache_stream.is_open())
+        {
+            return false;
+        }
 
-        write_pod(out_stream, static_cast<uint32_t>(scene.models.size()));
-        for (const pvp::ModelData& model : scene.models)
+        CacheHeader header{};
+        cache_stream.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!cache_stream || header.magic != cache_magic || header.version != cache_version || header.settings_hash != import_settings_hash(settings))
         {
-            write_vector(out_stream, model.vertices);
-            write_vector(out_stream, model.indices);
-            write_pod(out_stream, model.transform);
-            write_string(out_stream, model.diffuse_path);
-            write_string(out_stream, model.metallic_path);
-            write_string(out_stream, model.normal_path);
+            return false;
+        }
 
-            write_vector(out_stream, model.meshlets);
-            write_vector(out_stream, model.meshlet_vertices);
-            write_vector(out_stream, model.meshlet_triangles);
-            write_vector(out_stream, model.meshlet_sphere_bounds);
-            write_pod(out_stream, model.decompress_normals);
+        // Sizes read from the file are checked against it before anything is allocated for them
+        std::error_code size_error;
+        const uint64_t  cache_size = fs::file_size(cache_path(path, settings), size_error);
+        const uint64_t  table_size = uint64_t{ header.dependency_count } * sizeof(CacheDependencyEntry);
+        if (size_error || header.dependency_table_offset > cache_size || table_size > cache_size - header.dependency_table_offset)
+        {
+            return false;
         }
 
-        auto save_texture = [&](const pvp::TextureData& texture) {
-            write_string(out_stream, texture.name);
-            write_pod(out_stream, texture.width);
-            write_pod(out_stream, texture.height);
-            write_pod(out_stream, texture.format);
-            write_pod(out_stream, texture.generate_mip_maps);
-            write_vector(out_stream, texture.pixels);
-        };
+        std::vector<CacheDependencyEntry> dependency_table(header.dependency_count);
+        cache_stream.seekg(static_cast<std::streamoff>(header.dependency_table_offset));
+        cache_stream.read(reinterpret_cast<char*>(dependency_table.data()), static_cast<std::streamsize>(dependency_table.size() * sizeof(CacheDependencyEntry)));
+        if (!cache_stream)
+        {
+            return false;
+        }
 
-        write_pod(out_stream, static_cast<uint32_t>(scene.textures.size()));
-        for (const pvp::TextureData& texture : scene.textures)
+        // Catches a damaged table before any of its hashes are trusted
+        std::vector<uint64_t> combined_hashes{ header.settings_hash };
+        for (const CacheDependencyEntry& entry : dependency_table)
         {
-            save_texture(texture);
+            combined_hashes.push_back(entry.content_hash);
+        }
+        if (XXH3_64bits(combined_hashes.data(), combined_hashes.size() * sizeof(uint64_t)) != header.content_hash)
+        {
+            return false;
+        }
+
+        bool table_changed = false;
+        for (CacheDependencyEntry& entry : dependency_table)
+        {
+            if (entry.path.offset > cache_size || entry.path.size > cache_size - entry.path.offset)
+            {
+                return false;
+            }
+            std::string dependency(entry.path.size, '\0');
+            cache_stream.seekg(static_cast<std::streamoff>(entry.path.offset));
+            cache_stream.read(dependency.data(), static_cast<std::streamsize>(dependency.size()));
+
+            std::error_code error;
+            const uint64_t  file_size = fs::file_size(dependency, error);
+            if (!cache_stream || error || file_size != entry.file_size)
+            {
+                return false;
+            }
+
+            const int64_t current_write_time = write_time(dependency);
+            if (current_write_time == entry.write_time)
+            {
+                continue;
+            }
+
+            if (hash_file(dependency) != entry.content_hash)
+            {
+                return false;
+            }
+            entry.write_time = current_write_time;
+            table_changed = true;
         }
 
-        save_texture(scene.cube_map);
+        if (table_changed)
+        {
+            cache_stream.close();
+            std::fstream patch_stream(cache_path(path, settings), std::ios::binary | std::ios::in | std::ios::out);
+            if (patch_stream.is_open())
+            {
+                patch_stream.seekp(static_cast<std::streamoff>(header.dependency_table_offset));
+                patch_stream.write(reinterpret_cast<const char*>(dependency_table.data()), static_cast<std::streamsize>(dependency_table.size() * sizeof(CacheDependencyEntry)));
+            }
+            if (!patch_stream)
+            {
+                spdlog::warn("Can't update write times in scene cache {}, dependencies get hashed again next time", cache_path(path, settings).string());
+            }
+        }
+        return true;
     }
 
-    void load_cache(const std::filesystem::path& path, pvp::LoadedScene& scene)
+    std::optional<pvp::CachedScene> load_cache(const std::filesystem::path& path, const pvp::ImportSettings& settings)
     {
-        std::ifstream in_stream(fs::path("cache") / cached_string(path), std::ios::binary);
-
-        uint32_t model_size;
-        read_pod(in_stream, model_size);
-        scene.models.resize(model_size);
+        ZoneScoped;
+        pvp::CachedScene scene{ .file = pvp::MappedFile(cache_path(path, settings)) };
+        if (!scene.file.is_open())
+        {
+            return {};
+        }
 
-        for (pvp::ModelData& model : scene.models)
+        const std::span<const CacheHeader> header_span = scene.file.get_span<CacheHeader>(0, sizeof(CacheHeader));
+        if (header_span.empty())
+        {
+            return {};
+        }
+        const CacheHeader& header = header_span.front();
+        if (header.magic != cache_magic || header.version != cache_version || header.file_size != scene.file.get_data().size())
         {
-            read_vector(in_stream, model.vertices);
-            read_vector(in_stream, model.indices);
-            read_pod(in_stream, model.transform);
-            read_string(in_stream, model.diffuse_path);
-            read_string(in_stream, model.metallic_path);
-            read_string(in_stream, model.normal_path);
+            return {};
+        }
+        scene.vertex_format = static_cast<pvp::VertexFormat>(header.vertex_format);
 
-            read_vector(in_stream, model.meshlets);
-            read_vector(in_stream, model.meshlet_vertices);
-            read_vector(in_stream, model.meshlet_triangles);
-            read_vector(in_stream, model.meshlet_sphere_bounds);
-            read_pod(in_stream, model.decompress_normals);
+        const auto model_table = scene.file.get_span<CacheModelEntry>(header.model_table_offset, header.model_count * sizeof(CacheModelEntry));
+        const auto texture_table = scene.file.get_span<CacheTextureEntry>(header.texture_table_offset, (header.texture_count + 1ull) * sizeof(CacheTextureEntry));
+        const auto instance_table = scene.file.get_span<CacheInstanceEntry>(header.instance_table_offset, header.instance_count * sizeof(CacheInstanceEntry));
+        if (model_table.size() != header.model_count || instance_table.size() != header.instance_count || texture_table.size() != header.texture_count + 1ull)
+        {
+            return {};
         }
 
-        auto load_texture = [&](pvp::TextureData& texture) {
-            read_string(in_stream, texture.name);
-            read_pod(in_stream, texture.width);
-            read_pod(in_stream, texture.height);
-            read_pod(in_stream, texture.format);
-            read_pod(in_stream, texture.generate_mip_maps);
-            read_vector(in_stream, texture.pixels);
+        using DecodedStorage = std::vector<std::unique_ptr<std::byte[]>>;
+
+        // Stored sections are used straight from the mapping, encoded ones get decoded into their own allocation
+        std::atomic<bool> valid = true;
+        auto              section = [&]<typename T>(const CacheSection& cache_section, std::span<const T>& out, DecodedStorage& storage) {
+            if (cache_section.codec == CacheCodec::none && cache_section.zstd == 0)
+            {
+                out = scene.file.get_span<T>(cache_section.offset, cache_section.size);
+                if (out.size_bytes() != cache_section.size)
+                    valid = false;
+                return;
+            }
+
+            // The sizes come straight from the file, the stored range has to be inside it before anything is allocated
+            const std::span<const uint8_t> stored = scene.file.get_span<uint8_t>(cache_section.offset, cache_section.stored_size);
+            if (stored.size() != cache_section.stored_size || cache_section.size % sizeof(T) != 0)
+            {
+                valid = false;
+                return;
+            }
+
+            // A corrupt decoded size can still ask for more than there is, which has to reject the cache instead of
+            // escaping the parallel loop
+            std::unique_ptr<std::byte[]> decoded;
+            bool                         decoded_valid{};
+            try
+            {
+                decoded = std::make_unique_for_overwrite<std::byte[]>(cache_section.size);
+                decoded_valid = decode_section(cache_section, stored, std::span(reinterpret_cast<uint8_t*>(decoded.get()), cache_section.size));
+            }
+            catch (const std::bad_alloc&)
+            {
+                decoded_valid = false;
+            }
+            if (!decoded_valid)
+            {
+                valid = false;
+                return;
+            }
+            out = std::span<const T>(reinterpret_cast<const T*>(decoded.get()), cache_section.size / sizeof(T));
+            storage.push_back(std::move(decoded));
+        };
+        auto string_section = [&](const CacheSection& cache_section, std::string_view& out, DecodedStorage& storage) {
+            std::span<const char> chars;
+            section(cache_section, chars, storage);
+            out = std::string_view(chars.data(), chars.size());
+        };
+
+        auto load_model = [&](const CacheModelEntry& entry, pvp::CachedModel& model, DecodedStorage& storage) {
+            ZoneScopedN("Load model");
+            model.optimization_passes = static_cast<pvp::MeshOptimization>(entry.optimization_passes);
+            section(entry.vertices, model.vertices, storage);
+            section(entry.indices, model.indices, storage);
+            section(entry.meshlets, model.meshlets, storage);
+            section(entry.meshlet_vertices, model.meshlet_vertices, storage);
+            section(entry.meshlet_triangles, model.meshlet_triangles, storage);
+            section(entry.meshlet_sphere_bounds, model.meshlet_sphere_bounds, storage);
+            section(entry.meshlet_lods, model.meshlet_lods, storage);
+            section(entry.index_lods, model.index_lods, storage);
+            section(entry.packed_vertices, model.packed_vertices, storage);
+            model.position_offset = entry.position_offset;
+            model.position_scale = entry.position_scale;
+            model.base_meshlet_count = entry.base_meshlet_count;
+            model.bounds = entry.bounds;
+            model.aabb_min = entry.aabb_min;
+            model.aabb_max = entry.aabb_max;
+            if (model.meshlet_lods.size() != model.meshlets.size() || model.meshlet_sphere_bounds.size() != model.meshlets.size() ||
+                model.base_meshlet_count > model.meshlets.size())
+            {
+                valid = false;
+            }
+            // Meshlets index into the other sections without further checks, on the CPU and the GPU alike
+            if (std::ranges::any_of(model.meshlets, [&](const meshopt_Meshlet& meshlet) {
+                    return static_cast<uint64_t>(meshlet.vertex_offset) + meshlet.vertex_count > model.meshlet_vertices.size() ||
+                        static_cast<uint64_t>(meshlet.triangle_offset) + meshlet.triangle_count * 3ull > model.meshlet_triangles.size();
+                }) ||
+                std::ranges::any_of(model.meshlet_vertices, [&](uint32_t vertex) { return vertex >= model.vertex_count(); }))
+            {
+                valid = false;
+            }
+            if (model.index_lods.empty() || model.index_lods.size() > pvp::max_index_lods ||
+                std::ranges::any_of(model.index_lods, [&](const pvp::IndexLod& lod) { return static_cast<uint64_t>(lod.index_offset) + lod.index_count > model.indices.size(); }))
+            {
+                valid = false;
+            }
+        };
+
+        auto load_texture = [&](const CacheTextureEntry& entry, pvp::CachedTexture& texture, DecodedStorage& storage) {
+            ZoneScopedN("Load texture");
+            string_section(entry.name, texture.name, storage);
+            section(entry.pixels, texture.pixels, storage);
+            section(entry.levels, texture.levels, storage);
+            texture.width = entry.width;
+            texture.height = entry.height;
+            texture.format = entry.format;
+            texture.swizzle = entry.swizzle;
+            for (const pvp::TextureLevel& level : texture.levels)
+            {
+                if (level.offset + level.size > texture.pixels.size())
+                    valid = false;
+            }
         };
 
-        uint32_t texture_count;
-        read_pod(in_stream, texture_count);
-        scene.textures.resize(texture_count);
-        for (pvp::TextureData& texture : scene.textures)
+        // Every model and texture decodes on its own so compressed caches load on all cores
+        scene.models.resize(model_table.size());
+        scene.textures.resize(header.texture_count);
+        std::vector<DecodedStorage> storage(model_table.size() + texture_table.size());
+        std::vector<size_t>         load_jobs(storage.size());
+        std::iota(load_jobs.begin(), load_jobs.end(), size_t{ 0 });
+        std::for_each(std::execution::par, load_jobs.cbegin(), load_jobs.cend(), [&](size_t job) {
+            if (job < model_table.size())
+            {
+                load_model(model_table[job], scene.models[job], storage[job]);
+                return;
+            }
+            const size_t texture_index = job - model_table.size();
+            load_texture(texture_table[texture_index], texture_index < scene.textures.size() ? scene.textures[texture_index] : scene.cube_map, storage[job]);
+        });
+
+        for (DecodedStorage& job_storage : storage)
+        {
+            std::ranges::move(job_storage, std::back_inserter(scene.decoded_sections));
+        }
+
+        scene.instances.resize(instance_table.size());
+        for (size_t i = 0; i < instance_table.size(); ++i)
         {
-            load_texture(texture);
+            const CacheInstanceEntry& entry = instance_table[i];
+            pvp::CachedInstance&      instance = scene.instances[i];
+            instance.model_index = entry.model_index;
+            instance.transform = entry.transform;
+            instance.decompress_normals = entry.decompress_normals != 0;
+            string_section(entry.diffuse_path, instance.diffuse_path, scene.decoded_sections);
+            string_section(entry.metallic_path, instance.metallic_path, scene.decoded_sections);
+            string_section(entry.normal_path, instance.normal_path, scene.decoded_sections);
+            if (instance.model_index >= scene.models.size())
+                valid = false;
         }
 
-        load_texture(scene.cube_map);
+        if (!valid)
+        {
+            return {};
+        }
+        return scene;
     }
 
-    std::optional<pvp::LoadedScene> load_scene_from_disk(const std::filesystem::path& path)
+    std::optional<pvp::LoadedScene> load_scene_from_disk(const std::filesystem::path& path, const pvp::ImportSettings& settings)
     {
-        pvp::LoadedScene out_scene{};
-        const aiScene*   scene = aiImportFile(path.generic_string().c_str(), aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals | aiProcess_CalcTangentSpace);
+        const pvp::MeshletSettings& meshlet_settings = settings.meshlets;
+        if (meshlet_settings.max_vertices < 3 || meshlet_settings.max_vertices > pvp::max_meshlet_vertices ||
+            meshlet_settings.max_triangles < 1 || meshlet_settings.max_triangles > pvp::max_meshlet_triangles ||
+            meshlet_settings.min_triangles < 1 || meshlet_settings.min_triangles > meshlet_settings.max_triangles)
+        {
+            spdlog::error("Meshlet limits {} vertices, {}-{} triangles are outside what GpuMeshlet can encode",
+                          meshlet_settings.max_vertices,
+                          meshlet_settings.min_triangles,
+                          meshlet_settings.max_triangles);
+            return {};
+        }
+
+        pvp::LoadedScene      out_scene{ .vertex_format = settings.vertex_format };
+        std::set<std::string> dependencies{ path.generic_string() };
+
+        Assimp::Importer importer;
+        importer.SetIOHandler(new RecordingIOSystem(dependencies));
+        const aiScene* scene = importer.ReadFile(path.generic_string(), import_flags);
 
         if (scene == nullptr)
         {
-            spdlog::error("Failed to load model: {}", aiGetErrorString());
+            spdlog::error("Failed to load model: {}", importer.GetErrorString());
             return {};
         }
 
         std::unordered_map<std::string, aiTextureType> all_textures;
 
+        // Phase 1: walk the node tree. Every referenced aiMesh becomes one model, every reference one instance.
+        // Materials are resolved here so all_textures stays single threaded.
+        std::vector<const aiMesh*> mesh_jobs;
+        std::vector<uint32_t>      model_lookup(scene->mNumMeshes, std::numeric_limits<uint32_t>::max()); // aiMesh index -> model index
+
         std::function<void(const aiNode*, const aiMatrix4x4& parent_transform)> process_node;
         process_node = [&](const aiNode* node, const aiMatrix4x4& parent_transform) {
             const aiMatrix4x4 world_matrix = parent_transform * node->mTransformation;
 
             for (unsigned int i = 0; i < node->mNumMeshes; ++i)
             {
-                const aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+                const unsigned int mesh_index = node->mMeshes[i];
+                if (model_lookup[mesh_index] == std::numeric_limits<uint32_t>::max())
+                {
+                    model_lookup[mesh_index] = static_cast<uint32_t>(mesh_jobs.size());
+                    mesh_jobs.push_back(scene->mMeshes[mesh_index]);
+                }
+                out_scene.instances.push_back(pvp::ModelInstance{ .model_index = model_lookup[mesh_index], .transform = convert_matrix(world_matrix) });
+            }
+
+            for (unsigned int child_index = 0; child_index < node->mNumChildren; ++child_index)
+            {
+                process_node(node->mChildren[child_index], world_matrix);
+            }
+        };
+        process_node(scene->mRootNode, aiMatrix4x4());
 
-                pvp::ModelData model;
-                model.vertices.reserve(mesh->mNumVertices);
-                model.indices.reserve(mesh->mNumFaces * 3u);
-                model.transform = convert_matrix(world_matrix);
+        out_scene.models.resize(mesh_jobs.size());
+        for (pvp::ModelInstance& instance : out_scene.instances)
+        {
+            const aiMesh* mesh = mesh_jobs[instance.model_index];
 
-                for (unsigned int v = 0; v < mesh->mNumVertices; ++v)
+            if (scene->HasMaterials() && mesh->mMaterialIndex < scene->mNumMaterials)
+            {
+                const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+                aiString          tex_path;
+                if (material->GetTexture(aiTextureType_DIFFUSE, 0, &tex_path) == AI_SUCCESS)
                 {
-                    const aiVector3D& pos = mesh->mVertices[v];
-                    const aiVector3D& norm = mesh->mNormals[v];
-                    const aiVector3D& tangent = mesh->mTangents[v];
-                    const aiVector3D& texcoord = mesh->mTextureCoords[0][v];
-
-                    model.vertices.emplace_back(glm::vec3(pos.x, pos.y, pos.z),
-                                                glm::vec2(texcoord.x, texcoord.y),
-                                                glm::vec3(norm.x, norm.y, norm.z),
-                                                glm::vec3(tangent.x, tangent.y, tangent.z));
+                    instance.diffuse_path = tex_path.C_Str();
+                    all_textures[instance.diffuse_path] = aiTextureType_DIFFUSE;
                 }
-
-                for (unsigned int f = 0; f < mesh->mNumFaces; ++f)
+                if (material->GetTexture(aiTextureType_METALNESS, 0, &tex_path) == AI_SUCCESS)
                 {
-                    const aiFace& face = mesh->mFaces[f];
-                    for (unsigned int j = 0; j < face.mNumIndices; ++j)
-                        model.indices.push_back(face.mIndices[j]);
+                    instance.metallic_path = tex_path.C_Str();
+                    all_textures[instance.metallic_path] = aiTextureType_METALNESS;
                 }
-
-                if (scene->HasMaterials() && mesh->mMaterialIndex < scene->mNumMaterials)
+                if (material->GetTexture(aiTextureType_NORMALS, 0, &tex_path) == AI_SUCCESS)
                 {
-                    const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-                    aiString          tex_path;
-                    if (material->GetTexture(aiTextureType_DIFFUSE, 0, &tex_path) == AI_SUCCESS)
+                    instance.normal_path = tex_path.C_Str();
+                    all_textures[instance.normal_path] = aiTextureType_NORMALS;
+                    // TODO: REMOVE OMG THIS IS CRINGE
+                    if (std::filesystem::path(instance.normal_path).extension() == ".dds" || settings.texture_compression == pvp::TextureCompression::bcn)
                     {
-                        model.diffuse_path = tex_path.C_Str();
-                        all_textures[model.diffuse_path] = aiTextureType_DIFFUSE;
-                    }
-                    if (material->GetTexture(aiTextureType_METALNESS, 0, &tex_path) == AI_SUCCESS)
-                    {
-                        model.metallic_path = tex_path.C_Str();
-                        all_textures[model.metallic_path] = aiTextureType_METALNESS;
-                    }
-                    if (material->GetTexture(aiTextureType_NORMALS, 0, &tex_path) == AI_SUCCESS)
-                    {
-                        model.normal_path = tex_path.C_Str();
-                        all_textures[model.normal_path] = aiTextureType_NORMALS;
-                        // TODO: REMOVE OMG THIS IS CRINGE
-                        if (std::filesystem::path(model.normal_path).extension() == ".dds")
-                        {
-                            model.decompress_normals = true;
-                        }
+                        instance.decompress_normals = true;
                     }
                 }
+            }
+        }
 
-                generate_meshlet(model);
+        // Phase 2: convert geometry and build meshlets on all cores.
+        // Every job writes only to its own slot so the output order matches a serial run.
+        std::vector<size_t> job_indices(mesh_jobs.size());
+        std::iota(job_indices.begin(), job_indices.end(), size_t{ 0 });
+        std::for_each(std::execution::par, job_indices.cbegin(), job_indices.cend(), [&](size_t job_index) {
+            ZoneScopedN("Mesh import");
+            const aiMesh*   mesh = mesh_jobs[job_index];
+            pvp::ModelData& model = out_scene.models[job_index];
+            model.vertices.reserve(mesh->mNumVertices);
+            model.indices.reserve(mesh->mNumFaces * 3u);
+
+            for (unsigned int v = 0; v < mesh->mNumVertices; ++v)
+            {
+                const aiVector3D& pos = mesh->mVertices[v];
+                const aiVector3D& norm = mesh->mNormals[v];
+                const aiVector3D& tangent = mesh->mTangents[v];
+                const aiVector3D& texcoord = mesh->mTextureCoords[0][v];
+
+                model.vertices.emplace_back(glm::vec3(pos.x, pos.y, pos.z),
+                                            glm::vec2(texcoord.x, texcoord.y),
+                                            glm::vec3(norm.x, norm.y, norm.z),
+                                            glm::vec3(tangent.x, tangent.y, tangent.z));
+            }
 
-                out_scene.models.push_back(std::move(model));
+            for (unsigned int f = 0; f < mesh->mNumFaces; ++f)
+            {
+                const aiFace& face = mesh->mFaces[f];
+                for (unsigned int j = 0; j < face.mNumIndices; ++j)
+                    model.indices.push_back(face.mIndices[j]);
             }
 
-            for (unsigned int child_index = 0; child_index < node->mNumChildren; ++child_index)
+            optimize_mesh(model, settings.mesh_optimization);
+            generate_meshlet(model, settings.meshlets);
+            if (settings.meshlet_lods)
             {
-                process_node(node->mChildren[child_index], world_matrix);
+                build_meshlet_lods(model, settings.meshlets);
             }
-        };
-        process_node(scene->mRootNode, aiMatrix4x4());
+            sort_meshlets(model);
+            generate_index_lods(model);
+            compute_bounds(model);
+
+            if (settings.vertex_format == pvp::VertexFormat::packed)
+            {
+                pack_vertices(model);
+            }
+        });
+        sort_instances(out_scene);
 
         // Cubemap loading later
         {
@@ -388,97 +2167,18 @@ namespace
             // float* const pixels = stbi_loadf((path.parent_path() / "circus_arena_4k.hdr").string().c_str(), &width, &height, &channels, 4);
         }
 
-        for (const auto& [texture_name, texture_type] : all_textures)
-        {
-            pvp::TextureData loaded_texture{};
-
-            if (const aiTexture* data = scene->GetEmbeddedTexture(texture_name.c_str()); data != nullptr)
-            {
-                int const index = std::stoi(texture_name.substr(1));
-                int       tex_width{};
-                int       tex_height{};
-                int       channels{};
-
-                uint8_t* pixels = stbi_load_from_memory(reinterpret_cast<stbi_uc const*>(scene->mTextures[index]->pcData),
-                                                        static_cast<int>(scene->mTextures[index]->mWidth),
-                                                        &tex_width,
-                                                        &tex_height,
-                                                        &channels,
-                                                        STBI_rgb_alpha);
-
-                if (!pixels)
-                {
-                    spdlog::error("{}", stbi_failure_reason());
-                    throw std::runtime_error("failed to load texture image!");
-                }
-
-                const auto pixel_span = std::span(pixels, tex_height * tex_width * 4);
+        std::vector<std::pair<std::string, aiTextureType>> texture_jobs(all_textures.cbegin(), all_textures.cend());
+        out_scene.textures = decode_textures(scene, path.parent_path(), texture_jobs, settings.texture_compression);
+        deduplicate_textures(out_scene);
 
-                loaded_texture.width = tex_width;
-                loaded_texture.height = tex_height;
-                loaded_texture.pixels = std::vector(pixel_span.begin(), pixel_span.end());
-                loaded_texture.generate_mip_maps = true;
-                loaded_texture.name = texture_name;
-                switch (texture_type)
-                {
-                    case aiTextureType_DIFFUSE:
-                        loaded_texture.format = VK_FORMAT_R8G8B8A8_SRGB;
-                        break;
-                    default:
-                        loaded_texture.format = VK_FORMAT_R8G8B8A8_UNORM;
-                }
-            }
-            else // Not embeded loading from disk
+        for (const auto& [texture_name, texture_type] : texture_jobs)
+        {
+            if (scene->GetEmbeddedTexture(texture_name.c_str()) == nullptr)
             {
-                if (std::filesystem::path(texture_name).extension() == ".dds")
-                {
-                    dds::Image image;
-                    if (dds::readFile((path.parent_path() / texture_name).string(), &image) != dds::Success)
-                    {
-                        spdlog::error("Can't load dds texture {}", texture_name);
-                    }
-
-                    loaded_texture.format = dds::getVulkanFormat(image.format, true);
-                    loaded_texture.pixels = std::vector(image.mipmaps[0].cbegin(), image.mipmaps[0].cend());
-                    loaded_texture.width = image.width;
-                    loaded_texture.height = image.height;
-                    loaded_texture.generate_mip_maps = false;
-                    loaded_texture.name = texture_name;
-                }
-                else
-                {
-                    int      tex_width{};
-                    int      tex_height{};
-                    int      channels{};
-                    uint8_t* pixels = stbi_load((path.parent_path() / texture_name).string().c_str(), &tex_width, &tex_height, &channels, STBI_rgb_alpha);
-
-                    if (!pixels)
-                    {
-                        spdlog::error("{}", stbi_failure_reason());
-                        throw std::runtime_error("failed to load texture image!");
-                    }
-
-                    const auto pixel_span = std::span(pixels, tex_height * tex_width * 4);
-                    loaded_texture.width = tex_width;
-                    loaded_texture.height = tex_height;
-                    loaded_texture.pixels = std::vector(pixel_span.begin(), pixel_span.end());
-                    loaded_texture.generate_mip_maps = true;
-                    loaded_texture.name = texture_name;
-                    switch (texture_type)
-                    {
-                        case aiTextureType_DIFFUSE:
-                            loaded_texture.format = VK_FORMAT_R8G8B8A8_SRGB;
-                            break;
-                        default:
-                            loaded_texture.format = VK_FORMAT_R8G8B8A8_UNORM;
-                    }
-                }
+                dependencies.insert((path.parent_path() / texture_name).generic_string());
             }
-
-            out_scene.textures.push_back(loaded_texture);
         }
-
-        aiReleaseImport(scene);
+        out_scene.dependencies.assign(dependencies.cbegin(), dependencies.cend());
 
         // std::vector<meshopt_Meshlet> meshlets;
         // std::vector<uint32_t> meshlet_vertices;
@@ -493,31 +2193,105 @@ namespace
 
 } // namespace
 
-std::optional<pvp::LoadedScene> pvp::load_scene_cpu(const std::filesystem::path& path)
+std::optional<pvp::CachedScene> pvp::load_scene_cpu(const std::filesystem::path& path, const ImportSettings& settings)
 {
     ZoneScoped;
     if (!std::filesystem::exists(path))
     {
         return {};
     }
-    LoadedScene scene;
-    if (has_cache(path))
+
+    if (has_cache(path, settings) && dependencies_unchanged(path, settings))
+    {
+        if (std::optional<CachedScene> cached_scene = load_cache(path, settings); cached_scene.has_value())
+        {
+            return cached_scene;
+        }
+        spdlog::info("Scene cache for {} is outdated, importing again", path.string());
+    }
+
+    const std::optional<LoadedScene> maybe_scene = load_scene_from_disk(path, settings);
+    if (!maybe_scene.has_value())
+    {
+        return {};
+    }
+    // Scenes are only served from the mapped cache. Mapping whatever file is left on disk after a failed write could
+    // hand out a stale scene in place of the one just imported
+    if (!save_cache(path, settings, maybe_scene.value()))
+    {
+        spdlog::error("Imported {} but couldn't write its scene cache, not loading it", path.string());
+        return {};
+    }
+
+    return load_cache(path, settings);
+}
+
+bool pvp::cook_scene(const std::filesystem::path& path, const ImportSettings& settings, bool force)
+{
+    ZoneScoped;
+    if (!std::filesystem::exists(path))
+    {
+        spdlog::error("Scene {} does not exist", path.string());
+        return false;
+    }
+
+    if (!force && has_cache(path, settings) && dependencies_unchanged(path, settings))
+    {
+        return true;
+    }
+
+    const std::optional<LoadedScene> maybe_scene = load_scene_from_disk(path, settings);
+    if (!maybe_scene.has_value())
+    {
+        return false;
+    }
+    return save_cache(path, settings, maybe_scene.value());
+}
+
+pvp::CompactMeshlets pvp::compact_meshlets(const CachedModel& model)
+{
+    ZoneScoped;
+    CompactMeshlets out{};
+    const bool      short_vertices = model.vertex_count() <= 0x10000;
+
+    if (model.meshlet_vertices.size() > meshlet_offset_mask)
+    {
+        throw std::runtime_error("Model has too many meshlet vertices for the compact meshlet encoding");
+    }
+
+    if (short_vertices)
     {
-        load_cache(path, scene);
+        out.vertices.resize((model.meshlet_vertices.size() + 1) / 2);
+        for (size_t i = 0; i < model.meshlet_vertices.size(); ++i)
+        {
+            out.vertices[i / 2] |= model.meshlet_vertices[i] << (i % 2 * 16);
+        }
     }
     else
     {
-        std::optional<pvp::LoadedScene> maybe_scene = load_scene_from_disk(path);
-        if (maybe_scene.has_value())
+        out.vertices.assign(model.meshlet_vertices.begin(), model.meshlet_vertices.end());
+    }
+
+    out.meshlets.reserve(model.meshlets.size());
+    for (const meshopt_Meshlet& meshlet : model.meshlets)
+    {
+        const uint32_t triangle_offset = static_cast<uint32_t>(out.triangles.size());
+        if (triangle_offset > meshlet_offset_mask)
         {
-            scene = maybe_scene.value();
-            save_cache(path, scene);
+            throw std::runtime_error("Model has too many meshlet triangles for the compact meshlet encoding");
         }
-        else
+
+        for (uint32_t i = 0; i < meshlet.triangle_count; ++i)
         {
-            return {};
+            const uint8_t* triangle = &model.meshlet_triangles[meshlet.triangle_offset + i * 3];
+            out.triangles.push_back(triangle[0] | triangle[1] << 8 | triangle[2] << 16);
         }
+
+        out.meshlets.push_back(GpuMeshlet{
+            .vertex_data = meshlet.vertex_offset | (meshlet.vertex_count - 1) << meshlet_offset_bits | (short_vertices ? short_meshlet_vertices_bit : 0u),
+            .triangle_data = triangle_offset | (meshlet.triangle_count - 1) << meshlet_offset_bits,
+        });
     }
 
-    return scene;
+    return out;
 }
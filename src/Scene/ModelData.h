@@ -1,8 +1,14 @@
 ﻿#pragma once
+#include "MappedFile.h"
+
 #include <filesystem>
 #include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
 #include <meshoptimizer.h>
 #include <stb_image.h>
+#include <GraphicsPipeline/Vertex.h>
 #include <assimp/material.h>
 #include <glm/mat4x4.hpp>
 #include <vulkan/vulkan_core.h>
@@ -11,7 +17,81 @@ namespace pvp
 {
     struct Context;
     class Image;
-    struct Vertex;
+
+    enum class CacheCompression : uint32_t
+    {
+        none = 0,
+        meshopt,     // Geometry streams go through the meshoptimizer vertex/index codecs
+        meshopt_zstd // Additionally zstd on textures and the remaining sections
+    };
+
+    enum class TextureCompression : uint32_t
+    {
+        none = 0,
+        bcn // BC7 for color, BC5 for normals and metal-roughness. DDS files keep their own format
+    };
+
+    // meshoptimizer passes run on every mesh before meshlets are built. They always run in this order.
+    enum class MeshOptimization : uint32_t
+    {
+        none = 0,
+        remap = 1 << 0, // Weld duplicate vertices
+        vertex_cache = 1 << 1,
+        overdraw = 1 << 2,
+        vertex_fetch = 1 << 3,
+        all = remap | vertex_cache | overdraw | vertex_fetch
+    };
+    constexpr MeshOptimization operator|(MeshOptimization lhs, MeshOptimization rhs)
+    {
+        return static_cast<MeshOptimization>(static_cast<uint32_t>(lhs) | static_cast<uint32_t>(rhs));
+    }
+    constexpr bool has_pass(MeshOptimization passes, MeshOptimization pass)
+    {
+        return (static_cast<uint32_t>(passes) & static_cast<uint32_t>(pass)) != 0;
+    }
+
+    enum class MeshletBuilder : uint32_t
+    {
+        scan = 0, // meshopt_buildMeshlets, favours vertex reuse for rasterization
+        flex,     // meshopt_buildMeshletsFlex, splits large or badly shaped clusters for tighter cones and spheres
+        spatial   // meshopt_buildMeshletsSpatial, SAH clusters with the tightest bounds for culling
+    };
+
+    // Limits of the GpuMeshlet encoding
+    constexpr uint32_t max_meshlet_vertices = 128;
+    constexpr uint32_t max_meshlet_triangles = 256;
+
+    // max_vertices and max_triangles also size the mesh shader outputs, see PvpScene::get_meshlet_defines
+    struct MeshletSettings
+    {
+        MeshletBuilder builder{ MeshletBuilder::scan };
+        uint32_t       max_vertices{ 64 };
+        uint32_t       max_triangles{ 126 };
+        uint32_t       min_triangles{ 32 };  // flex and spatial only
+        float          cone_weight{ 0.25f }; // scan and flex only
+        float          split_factor{ 2.0f }; // flex only
+        float          fill_weight{ 0.5f };  // spatial only
+    };
+
+    // Options that change the import output. Every field is part of the cache key.
+    struct ImportSettings
+    {
+        VertexFormat       vertex_format{ VertexFormat::full };
+        CacheCompression   cache_compression{ CacheCompression::none };
+        TextureCompression texture_compression{ TextureCompression::none };
+        MeshOptimization   mesh_optimization{ MeshOptimization::all };
+        bool               meshlet_lods{ true }; // Build the simplified meshlet hierarchy on top of the source meshlets
+        MeshletSettings    meshlets{};
+    };
+
+    // One mip level inside TextureData::pixels
+    struct TextureLevel
+    {
+        uint64_t offset;
+        uint64_t size;
+        uint32_t width;
+        uint32_t height;
+    };
 
     struct TextureData
     {
@@ -20,43 +100,182 @@ namespace pvp
         uint32_t    height{};
         VkFormat    format{};
 
-        std::vector<uint8_t> pixels;
-        bool                 generate_mip_maps{};
+        std::vector<uint8_t>      pixels; // Every mip level, largest first
+        std::vector<TextureLevel> levels;
+        VkComponentMapping        swizzle{}; // Moves channels back to where the shaders expect them after block compression
     };
 
-    struct alignas(16) ConeBounds
+    // Culling bounds of one meshlet, matches PackedConeBounds in shared_structs.glsl.
+    // The cone is meshoptimizer's conservatively rounded snorm8 version, decoded by TransformCone.
+    struct ConeBounds
     {
         glm::vec4 sphere;
-        glm::vec4 cone;
-        // char      cone_axis_x;
-        // char      cone_axis_y;
-        // char      cone_axis_z;
-        // char      cone_cutoff;
+        int8_t    cone_axis_x;
+        int8_t    cone_axis_y;
+        int8_t    cone_axis_z;
+        int8_t    cone_cutoff;
+    };
+    static_assert(sizeof(ConeBounds) == 20);
+
+    // Level of detail bounds of one meshlet, matches MeshletLod in shared_structs.glsl.
+    // A meshlet is drawn when its own projected error is small enough but the one of its parent is not.
+    // Source meshlets have no error, meshlets that were never simplified further have a parent error of float max.
+    struct alignas(16) MeshletLod
+    {
+        glm::vec4 bounds;        // Sphere around the group this meshlet was simplified from
+        glm::vec4 parent_bounds; // Sphere around the group that got simplified from this meshlet
+        float     error;
+        float     parent_error;
+    };
+    static_assert(sizeof(MeshletLod) == 48);
+
+    // Meshlet header as the mesh shaders read it, decoded by decode_meshlet in shared_structs.glsl.
+    // vertex_data:   vertex offset in the low 24 bits, vertex count - 1 in the next 7, top bit set for 16 bit meshlet vertices
+    // triangle_data: triangle offset in the low 24 bits, triangle count - 1 in the top 8
+    struct GpuMeshlet
+    {
+        uint32_t vertex_data;
+        uint32_t triangle_data;
     };
+    static_assert(sizeof(GpuMeshlet) == 8);
 
+    // Meshlets re-encoded for upload. Triangles hold their three local indices in one uint each, meshlet vertices are
+    // packed two per uint when every vertex index of the model fits in 16 bits.
+    struct CompactMeshlets
+    {
+        std::vector<GpuMeshlet> meshlets;
+        std::vector<uint32_t>   vertices;
+        std::vector<uint32_t>   triangles;
+    };
+
+    // Range of ModelData::indices holding one discrete level of detail
+    struct IndexLod
+    {
+        uint32_t index_offset;
+        uint32_t index_count;
+        float    error; // World space simplification error, grows with the level
+    };
+
+    // Geometry of one aiMesh. Nodes referencing the same mesh share it through ModelInstance::model_index.
     struct ModelData
     {
         std::vector<Vertex>   vertices;
-        std::vector<uint32_t> indices;
-        glm::mat4x4           transform;
-        std::string           diffuse_path;
-        std::string           metallic_path;
-        std::string           normal_path;
-        bool                  decompress_normals;
+        std::vector<uint32_t> indices;                                       // Every level of index_lods back to back
+        MeshOptimization      optimization_passes{ MeshOptimization::none }; // Passes that ran on this mesh
+        std::vector<IndexLod> index_lods;                                    // Full detail first
+        glm::vec4             bounds{ 0.0f };                                // Bounding sphere, xyz center w radius
+        glm::vec3             aabb_min{ 0.0f };                              // Object space bounding box
+        glm::vec3             aabb_max{ 0.0f };
+
+        // Only one of vertices or packed_vertices is filled, depending on ImportSettings::vertex_format
+        std::vector<PackedVertex> packed_vertices;
+        glm::vec3                 position_offset{ 0.0f };
+        glm::vec3                 position_scale{ 1.0f };
 
         // MESHLETS
         std::vector<meshopt_Meshlet> meshlets;
         std::vector<uint32_t>        meshlet_vertices;
         std::vector<uint8_t>         meshlet_triangles;
         std::vector<ConeBounds>      meshlet_sphere_bounds;
+        std::vector<MeshletLod>      meshlet_lods;         // One per meshlet
+        uint32_t                     base_meshlet_count{}; // Meshlets of the source mesh, the coarser levels follow them
+    };
+
+    // One node placing a model in the scene
+    struct ModelInstance
+    {
+        uint32_t    model_index;
+        glm::mat4x4 transform;
+        std::string diffuse_path;
+        std::string metallic_path;
+        std::string normal_path;
+        bool        decompress_normals;
     };
 
     struct LoadedScene
     {
-        std::vector<ModelData>   models;
+        VertexFormat               vertex_format{ VertexFormat::full };
+        std::vector<ModelData>     models; // One per referenced aiMesh
+        std::vector<ModelInstance> instances;
         std::vector<TextureData> textures;
         TextureData              cube_map;
+
+        // Every file read during the import. Stored in the cache so edits to any of them invalidate it.
+        std::vector<std::string> dependencies;
+    };
+
+    // Views into a memory mapped scene cache. Only valid while the owning CachedScene is alive.
+    struct CachedTexture
+    {
+        std::string_view name{};
+        uint32_t         width{};
+        uint32_t         height{};
+        VkFormat         format{};
+
+        std::span<const uint8_t>      pixels;
+        std::span<const TextureLevel> levels;
+        VkComponentMapping            swizzle{};
     };
 
-    std::optional<LoadedScene> load_scene_cpu(const std::filesystem::path& path);
+    struct CachedModel
+    {
+        std::span<const Vertex>   vertices;
+        std::span<const uint32_t> indices;
+        MeshOptimization          optimization_passes;
+        std::span<const IndexLod> index_lods;
+        glm::vec4                 bounds;
+        glm::vec3                 aabb_min;
+        glm::vec3                 aabb_max;
+
+        std::span<const PackedVertex> packed_vertices;
+        glm::vec3                     position_offset;
+        glm::vec3                     position_scale;
+
+        size_t vertex_count() const
+        {
+            return vertices.empty() ? packed_vertices.size() : vertices.size();
+        }
+        std::span<const std::byte> vertex_bytes() const
+        {
+            return vertices.empty() ? std::as_bytes(packed_vertices) : std::as_bytes(vertices);
+        }
+
+        // MESHLETS
+        std::span<const meshopt_Meshlet> meshlets;
+        std::span<const uint32_t>        meshlet_vertices;
+        std::span<const uint8_t>         meshlet_triangles;
+        std::span<const ConeBounds>      meshlet_sphere_bounds;
+        std::span<const MeshletLod>      meshlet_lods;
+        uint32_t                         base_meshlet_count;
+    };
+
+    struct CachedInstance
+    {
+        uint32_t         model_index;
+        glm::mat4x4      transform;
+        std::string_view diffuse_path;
+        std::string_view metallic_path;
+        std::string_view normal_path;
+        bool             decompress_normals;
+    };
+
+    struct CachedScene
+    {
+        MappedFile                  file;
+        VertexFormat                vertex_format{ VertexFormat::full };
+        std::vector<CachedModel>    models;
+        std::vector<CachedInstance> instances;
+        std::vector<CachedTexture>  textures;
+        CachedTexture               cube_map;
+
+        // Sections that were compressed in the cache file are decoded into here instead of being used from the mapping
+        std::vector<std::unique_ptr<std::byte[]>> decoded_sections;
+    };
+
+    std::optional<CachedScene> load_scene_cpu(const std::filesystem::path& path, const ImportSettings& settings = {});
+    CompactMeshlets            compact_meshlets(const CachedModel& model);
+
+    // Imports the scene and writes its cache file unless an up to date one exists or force is set.
+    // Touches no Vulkan device so pvp-cook can run it on machines without a GPU.
+    bool cook_scene(const std::filesystem::path& path, const ImportSettings& settings = {}, bool force = false);
 } // namespace pvp
@@ -7,8 +7,10 @@
 #include <imgui.h>
 #include <stb_image.h>
 #include <Buffer/BufferBuilder.h>
+#include <Buffer/BufferPool.h>
 #include <CommandBuffer/CommandPool.h>
 #include <Context/Device.h>
+#include <Context/PhysicalDevice.h>
 #include <Debugger/Gizmos.h>
 #include <DescriptorSets/DescriptorLayoutCreator.h>
 #include <DescriptorSets/DescriptorLayoutBuilder.h>
@@ -17,8 +19,11 @@
 #include <GraphicsPipeline/Vertex.h>
 #include <Image/ImageBuilder.h>
 #include <Image/SamplerBuilder.h>
+#include <Renderer/Swapchain.h>
 #include <VMAAllocator/VmaAllocator.h>
+#include <algorithm>
 #include <assimp/material.h>
+#include <execution>
 #include <numeric>
 #include <Debugger/debugger.h>
 #include <glm/gtx/rotate_vector.hpp>
@@ -30,10 +35,12 @@
 
 pvp::PvpScene::PvpScene(Context& context)
     : m_context{ context }
+    , m_gpu_scene{ std::make_unique<GpuScene>() }
+    , m_staging_ring{ std::make_unique<StagingRing>(context, staging_ring_size) }
     , m_scene_globals{}
-    , m_point_lights_gpu{ 16 + sizeof(PointLight) * max_point_lights, context.allocator->get_allocator() }
-    , m_directonal_lights_gpu{ 16 + sizeof(DirectionLight) * max_direction_lights, context.allocator->get_allocator() }
-    , m_scene_globals_gpu{ sizeof(SceneGlobals), context.allocator->get_allocator() }
+    , m_point_lights_gpu{ 16 + sizeof(PointLight) * max_point_lights, *context.allocator }
+    , m_directonal_lights_gpu{ 16 + sizeof(DirectionLight) * max_direction_lights, *context.allocator }
+    , m_scene_globals_gpu{ sizeof(SceneGlobals), *context.allocator }
     , m_camera(context)
 {
     ZoneScoped;
@@ -72,16 +79,64 @@ pvp::PvpScene::PvpScene(Context& context)
         .set_tag(DiscriptorTag::bindless_textures)
         .get();
 
+    // The scene wide geometry buffers, see build_scene_descriptors. Passes build pipelines against it before any scene is loaded
+    m_context.descriptor_creator->get_layout()
+        .add_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT)
+        .add_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT)
+        .add_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT)
+        .add_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT)
+        .add_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT)
+        .add_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT)
+        .add_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT)
+        .add_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT)
+        .set_tag(DiscriptorTag::big_buffers)
+        .get();
+
     m_direction_light = DirectionLight{ { 0.557f, -0.557f, -0.557f, 0 }, { 1, 1, 1, 1.0f }, 10 };
 
     add_point_light(PointLight{ { 3, 0.1, 0, 0 }, { 1, 0, 0, 1.0f }, 100 });
     add_point_light(PointLight{ { 10, 2, -0.25f, 0 }, { 0, 1, 0, 1.0f }, 500 });
     add_direction_light(m_direction_light);
 
+    tune_meshlet_settings();
     scan_folder();
     ShaderLoader::init();
 }
 
+// Meshlet limits follow the mesh shader output the device prefers. Pipelines are built once with the matching defines,
+// so only the builder can change at runtime.
+void pvp::PvpScene::tune_meshlet_settings()
+{
+    VkPhysicalDeviceMeshShaderPropertiesEXT mesh_properties{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_PROPERTIES_EXT };
+    VkPhysicalDeviceProperties2             properties{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &mesh_properties };
+    vkGetPhysicalDeviceProperties2(m_context.physical_device->get_physical_device(), &properties);
+
+    MeshletSettings& meshlets = m_import_settings.meshlets;
+    m_mesh_group_size = std::clamp(mesh_properties.maxPreferredMeshWorkGroupInvocations, 32u, max_meshlet_vertices);
+    if (mesh_properties.prefersLocalInvocationVertexOutput || mesh_properties.prefersLocalInvocationPrimitiveOutput)
+    {
+        // Every invocation writes its own vertex and primitive, meshlets as large as the workgroup fill it in one pass
+        meshlets.max_vertices = m_mesh_group_size;
+        meshlets.max_triangles = m_mesh_group_size;
+    }
+    else if (mesh_properties.meshOutputPerPrimitiveGranularity > 2)
+    {
+        // Primitive output is allocated in granularity sized blocks, stay just below a full block like the 126 default does
+        const uint32_t granularity = mesh_properties.meshOutputPerPrimitiveGranularity;
+        meshlets.max_triangles = (meshlets.max_triangles + granularity - 1) / granularity * granularity - 2;
+    }
+    meshlets.max_vertices = std::min({ meshlets.max_vertices, mesh_properties.maxMeshOutputVertices, max_meshlet_vertices });
+    meshlets.max_triangles = std::min({ meshlets.max_triangles, mesh_properties.maxMeshOutputPrimitives, max_meshlet_triangles });
+    meshlets.min_triangles = std::min(meshlets.min_triangles, meshlets.max_triangles);
+
+    m_meshlet_defines = {
+        { "MESHLET_MAX_VERTICES", std::to_string(meshlets.max_vertices) },
+        { "MESHLET_MAX_TRIANGLES", std::to_string(meshlets.max_triangles) },
+        { "MESH_GROUP_SIZE", std::to_string(m_mesh_group_size) },
+    };
+    spdlog::info("Meshlets up to {} vertices and {} triangles, mesh workgroups of {}", meshlets.max_vertices, meshlets.max_triangles, m_mesh_group_size);
+}
+
 pvp::PvpScene::~PvpScene()
 {
     unload_scenes();
@@ -91,160 +146,325 @@ pvp::PvpScene::~PvpScene()
 void pvp::PvpScene::load_scene(const std::filesystem::path& path)
 {
     ZoneScoped;
+    load_scene_async(path);
+    poll_scene_load(true);
+}
 
-    const std::optional<LoadedScene> scene_optional = load_scene_cpu(path);
-    if (!scene_optional.has_value())
+void pvp::PvpScene::load_scene_async(const std::filesystem::path& path)
+{
+    ZoneScoped;
+    if (m_scene_load)
+    {
+        spdlog::warn("Still loading {}, ignoring {}", m_scene_load->path.string(), path.string());
         return;
+    }
 
-    unload_scenes();
-    const LoadedScene& loaded_scene = scene_optional.value();
-
-    const CommandPool     cmd_pool_transfer_buffers = CommandPool(m_context, *m_context.queue_families->get_queue_family(VK_QUEUE_TRANSFER_BIT, false), VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
-    const VkCommandBuffer cmd = cmd_pool_transfer_buffers.begin_buffer();
-    DestructorQueue       transfer_deleter{};
+    m_scene_load = std::make_unique<SceneLoad>();
+    m_scene_load->path = path;
+    m_scene_load->scene = std::make_unique<GpuScene>();
+    // The settings are copied, the debug UI keeps editing them while the worker runs
+    m_scene_load->worker = std::thread(&PvpScene::build_scene,
+                                       this,
+                                       std::ref(*m_scene_load),
+                                       m_import_settings,
+                                       m_stream_geometry,
+                                       static_cast<VkDeviceSize>(m_streaming_pool_mib) << 20);
+}
 
-    load_default_textures(transfer_deleter, cmd);
-    load_textures(loaded_scene, transfer_deleter, cmd);
+bool pvp::PvpScene::is_loading() const
+{
+    return m_scene_load != nullptr;
+}
 
-    big_buffer_generation(loaded_scene, transfer_deleter, cmd);
+void pvp::PvpScene::build_scene(SceneLoad& load, const ImportSettings settings, const bool streaming, const VkDeviceSize pool_size)
+{
+    ZoneScoped;
+    // The render thread may be waiting for the worker to either ask for a submit or be done
+    auto finish_stage = [&load](const SceneLoadStage stage) {
+        {
+            std::lock_guard lock(load.submit_mutex);
+            load.stage = stage;
+        }
+        load.submit_changed.notify_all();
+    };
+    try
+    {
+        std::optional<CachedScene> scene_optional = load_scene_cpu(load.path, settings);
+        if (!scene_optional.has_value())
+        {
+            finish_stage(SceneLoadStage::failed);
+            return;
+        }
+        load.stage = SceneLoadStage::uploading;
 
-    m_gpu_models.reserve(m_gpu_models.size() + loaded_scene.models.size());
+        GpuScene&          scene = *load.scene;
+        const CachedScene& loaded_scene = scene_optional.value();
+        scene.vertex_format = loaded_scene.vertex_format;
 
-    for (const ModelData& cpu_model : loaded_scene.models)
-    {
-        ZoneScopedN("Model");
-        // transfer_to_gpu(cpu_model.vertices, m_gpu_vertices, offset_vertex);
-        // transfer_to_gpu(cpu_model.indices, m_gpu_indices, offset_indices);
+        // Only recorded here. The transfer queue is usually the graphics queue, so the render thread does the submits.
+        // The pool is only touched by one thread at a time, the worker is blocked while the render thread submits
+        load.transfer_pool = CommandPool(m_context, *m_context.queue_families->get_queue_family(VK_QUEUE_TRANSFER_BIT, false), VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+        load.uploader = std::make_unique<StagingUploader>(*m_staging_ring, load.transfer_pool, [this, &load](VkCommandBuffer cmd) {
+            return submit_scene_upload(load, cmd);
+        });
+        StagingUploader& uploader = *load.uploader;
+        const float      upload_steps = 3.0f;
 
-        Model& gpu_model = m_gpu_models.emplace_back();
+        load_default_textures(scene, uploader);
+        load_textures(scene, loaded_scene, uploader);
+        load.progress = 1.0f / upload_steps;
 
-        auto transfer_to_gpu = [this, &transfer_deleter, &cmd]<typename T>(const std::span<T> data, Buffer& gpu_buffer, VkBufferUsageFlags usage, const std::string& name = "") {
-            Buffer transfer_buffer{};
-            BufferBuilder()
-                .set_size(data.size_bytes())
-                .set_usage(VK_BUFFER_USAGE_TRANSFER_SRC_BIT)
-                .set_flags(VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT)
-                .set_memory_usage(VMA_MEMORY_USAGE_AUTO_PREFER_HOST)
-                .build(m_context.allocator->get_allocator(), transfer_buffer);
+        scene.models.reserve(scene.models.size() + loaded_scene.models.size());
+        for (const CachedModel& cpu_model : loaded_scene.models)
+        {
+            Model& gpu_model = scene.models.emplace_back();
+            gpu_model.index_count = cpu_model.index_lods[0].index_count;
+            gpu_model.index_lods.assign(cpu_model.index_lods.begin(), cpu_model.index_lods.end());
+            gpu_model.meshlet_count = cpu_model.base_meshlet_count;
+            gpu_model.lod_meshlet_count = cpu_model.meshlets.size();
+            // Geometry stays in the cache file until the streamer pages it in
+            gpu_model.resident = !streaming;
+        }
+        if (!streaming)
+        {
+            upload_geometry(scene, loaded_scene, uploader);
+        }
+        else
+        {
+            // Numbered like upload_geometry would, the pointer path finds the meshlets themselves in the pool
+            uint32_t meshlet_offset{};
+            for (Model& gpu_model : scene.models)
+            {
+                gpu_model.meshlet_offset = meshlet_offset;
+                meshlet_offset += gpu_model.lod_meshlet_count;
+            }
+        }
+        load.progress = 2.0f / upload_steps;
 
-            transfer_buffer.copy_data_into_buffer(data);
-            transfer_deleter.add_to_queue([transfer_buffer] {
-                transfer_buffer.destroy();
-            });
+        scene.instances.reserve(scene.instances.size() + loaded_scene.instances.size());
+        for (const CachedInstance& cpu_instance : loaded_scene.instances)
+        {
+            const CachedModel& cpu_model = loaded_scene.models[cpu_instance.model_index];
+            Instance&          gpu_instance = scene.instances.emplace_back();
+            gpu_instance.model_index = cpu_instance.model_index;
+
+            gpu_instance.material.transform = cpu_instance.transform;
+            gpu_instance.material.normal_decompression = cpu_instance.decompress_normals;
+            gpu_instance.material.position_offset = cpu_model.position_offset;
+            gpu_instance.material.position_scale = cpu_model.position_scale;
+            gpu_instance.material.vertex_format = loaded_scene.vertex_format;
+
+            gpu_instance.material.diffuse_texture_index = cpu_instance.diffuse_path.empty() ?
+                1 :
+                std::ranges::find_if(scene.textures, [&](StaticImage& image) { return cpu_instance.diffuse_path == image.get_name(); }) - scene.textures.begin();
+            gpu_instance.material.normal_texture_index = cpu_instance.normal_path.empty() ?
+                2 :
+                std::ranges::find_if(scene.textures, [&](StaticImage& image) { return cpu_instance.normal_path == image.get_name(); }) - scene.textures.begin();
+            gpu_instance.material.metalness_texture_index = cpu_instance.metallic_path.empty() ?
+                0 :
+                std::ranges::find_if(scene.textures, [&](StaticImage& image) { return cpu_instance.metallic_path == image.get_name(); }) - scene.textures.begin();
+
+            const glm::mat4& transform = cpu_instance.transform;
+            const float      max_scale = std::max({ glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])) });
+            std::array<float, max_index_lods> level_errors{};
+            for (size_t level = 0; level < cpu_model.index_lods.size(); ++level)
+            {
+                level_errors[level] = cpu_model.index_lods[level].error * max_scale;
+            }
+            scene.lod_input.add(glm::vec3(transform * glm::vec4(glm::vec3(cpu_model.bounds), 1.0f)),
+                                cpu_model.bounds.w * max_scale,
+                                std::span(level_errors).first(cpu_model.index_lods.size()));
+            scene.instance_bounds.push_back(Aabb{ .min = cpu_model.aabb_min, .max = cpu_model.aabb_max }.transformed(transform));
+        }
+        scene.bvh.build(scene.instance_bounds);
 
+        {
             BufferBuilder()
-                .set_size(data.size_bytes())
-                .set_usage(usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_2_SHADER_DEVICE_ADDRESS_BIT)
+                .set_size(loaded_scene.instances.size() * sizeof(MaterialTransform))
+                .set_usage(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT)
                 .set_memory_usage(VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE)
-                .build(m_context.allocator->get_allocator(), gpu_buffer);
-            gpu_buffer.copy_from_buffer(cmd, transfer_buffer);
+                .set_pool(m_context.allocator->get_device_pool())
+                .build(m_context.allocator->get_allocator(), scene.matrix);
+            scene.destructor_queue.add_to_queue([&scene] { scene.matrix.destroy(); });
 
-            debugger::add_object_name(m_context.device, gpu_buffer.get_buffer(), name);
-        };
+            std::vector<MaterialTransform> all_matricies;
+            all_matricies.reserve(loaded_scene.instances.size());
+            for (const Instance& instance : scene.instances)
+            {
+                all_matricies.push_back(instance.material);
+            }
+            uploader.upload(std::span<const MaterialTransform>(all_matricies), scene.matrix);
+        }
+
+        if (streaming)
+        {
+            // Takes the cache mapping along, loaded_scene is not valid past this point
+            scene.streamer = std::make_unique<GeometryStreamer>(m_context, std::move(scene_optional.value()), pool_size, streaming_upload_budget);
+        }
 
-        transfer_to_gpu(std::span(cpu_model.vertices), gpu_model.vertex_data, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, "Mesh vertex data");
+        build_draw_calls(scene);
 
-        // Index loading
-        transfer_to_gpu(std::span(cpu_model.indices), gpu_model.index_data, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, "indcies");
-        gpu_model.index_count = cpu_model.indices.size();
-        gpu_model.meshlet_count = cpu_model.meshlets.size();
+        load.cmd = uploader.finish();
+        load.progress = 1.0f;
+        finish_stage(SceneLoadStage::recorded);
+    }
+    catch (const std::exception& error)
+    {
+        spdlog::error("Loading {} failed: {}", load.path.string(), error.what());
+        finish_stage(SceneLoadStage::failed);
+    }
+}
 
-        // meshletes loading
-        transfer_to_gpu(std::span(cpu_model.meshlets), gpu_model.meshlet_buffer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, "Meshlets");
-        transfer_to_gpu(std::span(cpu_model.meshlet_triangles), gpu_model.meshlet_triangles_buffer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, "Meshlet triangle");
-        transfer_to_gpu(std::span(cpu_model.meshlet_vertices), gpu_model.meshlet_vertices_buffer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, "Meshlet vertex index");
-        transfer_to_gpu(std::span(cpu_model.meshlet_sphere_bounds), gpu_model.meshlet_sphere_bounds_buffer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, "Meshlet sphere bounds");
-        DescriptorSetBuilder{}
-            .set_layout(m_context.descriptor_creator->get_layout()
-                            .add_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_MESH_BIT_EXT | VK_SHADER_STAGE_TASK_BIT_EXT)
-                            .add_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_MESH_BIT_EXT | VK_SHADER_STAGE_TASK_BIT_EXT)
-                            .add_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_MESH_BIT_EXT | VK_SHADER_STAGE_TASK_BIT_EXT)
-                            .add_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_MESH_BIT_EXT | VK_SHADER_STAGE_TASK_BIT_EXT)
-                            .add_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_MESH_BIT_EXT | VK_SHADER_STAGE_TASK_BIT_EXT)
-                            .set_tag(DiscriptorTag::meshlets)
-                            .get())
-            .bind_buffer_ssbo(0, gpu_model.meshlet_buffer)
-            .bind_buffer_ssbo(1, gpu_model.vertex_data)
-            .bind_buffer_ssbo(2, gpu_model.meshlet_vertices_buffer)
-            .bind_buffer_ssbo(3, gpu_model.meshlet_triangles_buffer)
-            .bind_buffer_ssbo(4, gpu_model.meshlet_sphere_bounds_buffer)
-            .build(m_context, gpu_model.meshlet_descriptor_set);
-
-        gpu_model.material.transform = cpu_model.transform;
-        gpu_model.material.normal_decompression = cpu_model.decompress_normals;
-
-        gpu_model.material.diffuse_texture_index = cpu_model.diffuse_path.empty() ?
-            1 :
-            std::ranges::find_if(m_gpu_textures, [&](StaticImage& image) { return cpu_model.diffuse_path == image.get_name(); }) - m_gpu_textures.begin();
-        gpu_model.material.normal_texture_index = cpu_model.normal_path.empty() ?
-            2 :
-            std::ranges::find_if(m_gpu_textures, [&](StaticImage& image) { return cpu_model.normal_path == image.get_name(); }) - m_gpu_textures.begin();
-        gpu_model.material.metalness_texture_index = cpu_model.metallic_path.empty() ?
-            0 :
-            std::ranges::find_if(m_gpu_textures, [&](StaticImage& image) { return cpu_model.metallic_path == image.get_name(); }) - m_gpu_textures.begin();
-
-        // auto get_address = [&](VkBuffer buffer) -> VkDeviceAddress {
-        //     VkBufferDeviceAddressInfo address_info{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO_KHR, .pNext = nullptr, .buffer = buffer };
-        //     return vkGetBufferDeviceAddress(m_context.device->get_device(), &address_info);
-        // };
-
-        // gpu_model.ptr_to_buffers.vertex_data = get_address(gpu_model.vertex_data.get_buffer());
-        // gpu_model.ptr_to_buffers.meshlet_data = get_address(gpu_model.meshlet_buffer.get_buffer());
-        // gpu_model.ptr_to_buffers.meshlet_vertices_data = get_address(gpu_model.meshlet_vertices_buffer.get_buffer());
-        // gpu_model.ptr_to_buffers.meshlet_triangle_data = get_address(gpu_model.meshlet_triangles_buffer.get_buffer());
-        // gpu_model.ptr_to_buffers.meshlet_sphere_bounds_data = get_address(gpu_model.meshlet_sphere_bounds_buffer.get_buffer());
-    }
-
-    {
-        BufferBuilder()
-            .set_size(loaded_scene.models.size() * sizeof(MaterialTransform))
-            .set_usage(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT)
-            .set_memory_usage(VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE)
-            .build(m_context.allocator->get_allocator(), m_gpu_matrix);
-        m_scene_destructor_queue.add_to_queue([&] { m_gpu_matrix.destroy(); });
+pvp::SubmitTicket pvp::PvpScene::submit_scene_upload(SceneLoad& load, const VkCommandBuffer cmd)
+{
+    std::unique_lock lock(load.submit_mutex);
+    load.submit_request = cmd;
+    load.submit_changed.notify_all();
+    load.submit_changed.wait(lock, [&load] { return load.submit_request == VK_NULL_HANDLE; });
+    return load.submit_ticket;
+}
 
-        std::vector<MaterialTransform> all_matricies;
-        all_matricies.reserve(loaded_scene.models.size());
-        for (const Model& model : m_gpu_models)
+void pvp::PvpScene::serve_scene_uploads(SceneLoad& load, const bool wait)
+{
+    std::unique_lock lock(load.submit_mutex);
+    while (true)
+    {
+        if (load.submit_request != VK_NULL_HANDLE)
+        {
+            load.submit_ticket = load.transfer_pool.submit(load.submit_request);
+            load.submit_request = VK_NULL_HANDLE;
+            load.submit_changed.notify_all();
+        }
+        const SceneLoadStage stage = load.stage;
+        if (!wait || (stage != SceneLoadStage::importing && stage != SceneLoadStage::uploading))
         {
-            all_matricies.push_back(model.material);
+            return;
         }
-        m_gpu_matrix.copy_data_from_tmp_buffer(m_context, cmd, std::span(all_matricies), transfer_deleter);
+        load.submit_changed.wait(lock, [&load] {
+            return load.submit_request != VK_NULL_HANDLE || (load.stage != SceneLoadStage::importing && load.stage != SceneLoadStage::uploading);
+        });
+    }
+}
+
+// Moves the pending load along without blocking, or all the way through when waiting. The swap happens here, in update(),
+// so every pass of a frame draws the same scene
+void pvp::PvpScene::poll_scene_load(const bool wait)
+{
+    ZoneScoped;
+    if (!m_scene_load)
+    {
+        return;
+    }
+    SceneLoad& load = *m_scene_load;
+
+    serve_scene_uploads(load, wait);
+    const SceneLoadStage stage = load.stage;
+    if (stage == SceneLoadStage::importing || stage == SceneLoadStage::uploading)
+    {
+        return;
+    }
+    if (load.worker.joinable())
+    {
+        load.worker.join();
+    }
+
+    if (load.stage == SceneLoadStage::failed)
+    {
+        spdlog::error("Failed to load {}", load.path.string());
+        cancel_scene_load();
+        return;
+    }
+
+    if (load.stage == SceneLoadStage::recorded)
+    {
+        // Swapped in right away, the frames drawing it wait for the upload on the GPU through record_transfers
+        load.ticket = load.transfer_pool.submit(load.cmd);
+        load.stage = SceneLoadStage::submitted;
+
+        std::unique_ptr<GpuScene> scene = std::move(load.scene);
+        build_scene_descriptors(*scene);
+
+        // Frames already submitted still read the old scene
+        m_retired_scenes.push_back(RetiredScene{ std::move(m_gpu_scene), max_frames_in_flight });
+        m_gpu_scene = std::move(scene);
+        m_instance_lods.assign(m_gpu_scene->instances.size(), 0);
+        m_visible_instances.clear();
     }
 
-    cmd_pool_transfer_buffers.end_buffer(cmd);
-    transfer_deleter.destroy_and_clear();
-    cmd_pool_transfer_buffers.destroy();
+    if (wait)
+    {
+        load.transfer_pool.wait(load.ticket);
+    }
+    else if (!load.transfer_pool.is_done(load.ticket))
+    {
+        return;
+    }
+
+    // Frees the command buffers, everything copied out of the ring has landed
+    load.transfer_pool.destroy();
+    const UploadStats& upload_stats = load.uploader->get_stats();
+    spdlog::info("Loaded {}, {} extra upload submits, {:.1f}ms waiting for staging space",
+                 load.path.string(),
+                 upload_stats.submits.load(),
+                 static_cast<float>(upload_stats.stall_micros.load()) / 1000.0f);
+    load.uploader.reset();
+    m_staging_ring->release_all();
+    m_scene_load.reset();
+}
+
+// Drops a load before it finishes. Imports can't be stopped halfway, so this waits for the worker
+void pvp::PvpScene::cancel_scene_load()
+{
+    if (!m_scene_load)
+    {
+        return;
+    }
+    SceneLoad& load = *m_scene_load;
+    // The worker may be waiting for a submit to make room in the ring
+    serve_scene_uploads(load, true);
+    if (load.worker.joinable())
+    {
+        load.worker.join();
+    }
+
+    // The pool exists once the uploader does. Waits for whatever was submitted, unsubmitted buffers are just freed
+    if (load.uploader)
+    {
+        load.transfer_pool.destroy();
+        load.uploader.reset();
+        m_staging_ring->release_all();
+    }
+    // Already swapped in once submitted, the current scene owns it then
+    if (load.scene)
+    {
+        destroy_gpu_scene(*load.scene);
+    }
+    m_scene_load.reset();
+}
 
+void pvp::PvpScene::build_scene_descriptors(GpuScene& scene)
+{
+    ZoneScoped;
     DescriptorSetBuilder()
         .set_layout(m_context.descriptor_creator->get_layout().from_tag(DiscriptorTag::bindless_textures).get())
         .bind_sampler(0, m_shadered_sampler)
-        .bind_image_array(1, m_gpu_textures)
-        .build(m_context, m_all_textures);
-
-    build_draw_calls();
+        .bind_image_array(1, scene.textures)
+        .build(m_context, scene.all_textures);
 
-    DescriptorSetBuilder{}
-        .set_layout(m_context.descriptor_creator->get_layout()
-                        .add_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT)
-                        .add_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT)
-                        .add_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT)
-                        .add_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT)
-                        .add_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT)
-                        .add_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT)
-                        .add_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT)
-                        .add_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT)
-                        .set_tag(DiscriptorTag::big_buffers)
-                        .get())
-        .bind_buffer_ssbo(0, get_indirect_draw_calls())
-        .bind_buffer_ssbo(1, get_matrix_buffer())
-        .bind_buffer_ssbo(2, get_meshlets_buffer())
-        .bind_buffer_ssbo(3, get_all_vertex_buffer())
-        .bind_buffer_ssbo(4, get_meshlets_vertices_buffer())
-        .bind_buffer_ssbo(5, get_meshlets_triangles_buffer())
-        .bind_buffer_ssbo(6, get_meshlets_sphere_bounds_buffer())
-        .bind_buffer_ssbo(7, get_pointers())
-        .build(m_context, m_indirect_descriptor);
+    if (!scene.streamer)
+    {
+        DescriptorSetBuilder{}
+            .set_layout(m_context.descriptor_creator->get_layout().from_tag(DiscriptorTag::big_buffers).get())
+            .bind_buffer_ssbo(0, scene.indirect_draw_calls)
+            .bind_buffer_ssbo(1, scene.matrix)
+            .bind_buffer_ssbo(2, scene.meshlets)
+            .bind_buffer_ssbo(3, scene.vertices)
+            .bind_buffer_ssbo(4, scene.meshlets_vertices)
+            .bind_buffer_ssbo(5, scene.meshlets_triangles)
+            .bind_buffer_ssbo(6, scene.meshlets_sphere_bounds)
+            .bind_buffer_ssbo(7, scene.geometry)
+            .build(m_context, scene.indirect_descriptor);
+    }
 
     DescriptorSetBuilder{}
         .set_layout(m_context.descriptor_creator->get_layout()
@@ -252,37 +472,53 @@ void pvp::PvpScene::load_scene(const std::filesystem::path& path)
                         .add_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT)
                         .set_tag(DiscriptorTag::pointers)
                         .get())
-        .bind_buffer_ssbo(0, m_gpu_indirect_draw_calls)
-        .bind_buffer_ssbo(1, m_pointers)
-        .build(m_context, m_indirect_descriptor_ptr);
+        .bind_buffer_ssbo(0, scene.indirect_draw_calls)
+        .bind_buffer_ssbo(1, scene.pointers)
+        .build(m_context, scene.indirect_descriptor_ptr);
 
-    // m_scene_globals_gpu = UniformBuffer{};
-    // m_point_lights_gpu = UniformBuffer(16 + sizeof(PointLight) * max_point_lights, context.allocator->get_allocator());
-    // m_directonal_lights_gpu = UniformBuffer(16 + sizeof(DirectionLight) * max_direction_lights, context.allocator->get_allocator());
+    scene.has_descriptors = true;
 }
-void pvp::PvpScene::unload_scenes()
+
+void pvp::PvpScene::destroy_gpu_scene(GpuScene& scene) const
 {
-    vkDeviceWaitIdle(m_context.device->get_device());
-    m_scene_destructor_queue.destroy_and_clear();
+    scene.destructor_queue.destroy_and_clear();
 
-    for (const Model& model : m_gpu_models)
+    // The geometry buffers went with the destructor queue, streamed geometry goes with the streamer
+    if (scene.has_descriptors)
     {
-        model.vertex_data.destroy();
-        model.index_data.destroy();
-        model.meshlet_buffer.destroy();
-        model.meshlet_vertices_buffer.destroy();
-        model.meshlet_triangles_buffer.destroy();
-        model.meshlet_sphere_bounds_buffer.destroy();
-
-        model.meshlet_descriptor_set.destroy();
+        scene.all_textures.destroy();
+        scene.indirect_descriptor_ptr.destroy();
+        if (!scene.streamer)
+        {
+            scene.indirect_descriptor.destroy();
+        }
     }
-    m_gpu_models.clear();
+    scene.streamer.reset();
 
-    for (const StaticImage& gpu_texture : m_gpu_textures)
+    for (const StaticImage& gpu_texture : scene.textures)
     {
         gpu_texture.destroy(m_context);
     }
-    m_gpu_textures.clear();
+    scene.textures.clear();
+}
+
+void pvp::PvpScene::unload_scenes()
+{
+    vkDeviceWaitIdle(m_context.device->get_device());
+    if (m_scene_load)
+    {
+        cancel_scene_load();
+    }
+    for (RetiredScene& retired : m_retired_scenes)
+    {
+        destroy_gpu_scene(*retired.scene);
+    }
+    m_retired_scenes.clear();
+
+    destroy_gpu_scene(*m_gpu_scene);
+    m_gpu_scene = std::make_unique<GpuScene>();
+    m_instance_lods.clear();
+    m_visible_instances.clear();
 }
 
 uint32_t pvp::PvpScene::add_point_light(const PointLight& light)
@@ -384,6 +620,17 @@ void pvp::PvpScene::update()
         }
     }
 
+    // Swapped out scenes go once every frame that could have been recorded with them is waited on
+    std::erase_if(m_retired_scenes, [this](RetiredScene& retired) {
+        if (retired.frames_left-- > 0)
+        {
+            return false;
+        }
+        destroy_gpu_scene(*retired.scene);
+        return true;
+    });
+    poll_scene_load(false);
+
     gizmos::clear();
 
     m_camera.update(delta_time);
@@ -397,8 +644,43 @@ void pvp::PvpScene::update()
         m_scene_globals.positon = m_camera.get_position();
         m_scene_globals.cone = m_camera.get_cone();
         m_scene_globals.radar_cull_data = m_camera.get_radar_cull();
+        m_frustum = Frustum::from_matrix(m_scene_globals.camera_projection_view);
     }
     m_scene_globals.culling_mode = static_cast<int32_t>(m_cull_mode);
+    const float lod_error_scale = m_camera.get_projection_matrix()[1][1] * 0.5f * static_cast<float>(m_context.swapchain->get_swapchain_extent().height);
+    m_scene_globals.lod_error_scale = m_lod_enabled ? lod_error_scale / m_lod_pixel_error : 0.0f;
+
+    if (m_lod_enabled)
+    {
+        select_lods(m_gpu_scene->lod_input,
+                    LodSelectionView{
+                        .camera_position = m_scene_globals.positon,
+                        .near_plane = m_scene_globals.radar_cull_data.near_plane,
+                        .error_scale = lod_error_scale,
+                        .pixel_error = m_lod_pixel_error,
+                        .min_coverage = lod_min_coverage,
+                    },
+                    m_instance_lods);
+    }
+    else
+    {
+        std::ranges::fill(m_instance_lods, 0);
+    }
+
+    if (m_cull_mode == CullMode::none)
+    {
+        m_visible_instances.resize(m_gpu_scene->instances.size());
+        std::iota(m_visible_instances.begin(), m_visible_instances.end(), 0u);
+    }
+    else
+    {
+        m_gpu_scene->bvh.query_frustum(m_frustum, m_visible_instances);
+    }
+
+    if (m_gpu_scene->streamer)
+    {
+        update_streaming();
+    }
 
     gizmos::draw_cone(m_scene_globals.cone.tip, m_scene_globals.cone.height, m_scene_globals.cone.direction, m_scene_globals.cone.angle);
 
@@ -437,13 +719,41 @@ void pvp::PvpScene::update()
             ImGui::EndCombo();
         }
 
+        constexpr std::array<const char*, 2> vertex_formats{ "Full", "Packed" };
+        ImGui::Combo("Vertex format", reinterpret_cast<int*>(&m_import_settings.vertex_format), vertex_formats.data(), vertex_formats.size());
+        constexpr std::array<const char*, 3> cache_compressions{ "None", "meshopt", "meshopt + zstd" };
+        ImGui::Combo("Cache compression", reinterpret_cast<int*>(&m_import_settings.cache_compression), cache_compressions.data(), cache_compressions.size());
+        constexpr std::array<const char*, 2> texture_compressions{ "None", "BCn" };
+        ImGui::Combo("Texture compression", reinterpret_cast<int*>(&m_import_settings.texture_compression), texture_compressions.data(), texture_compressions.size());
+        auto* const mesh_optimization = reinterpret_cast<unsigned int*>(&m_import_settings.mesh_optimization);
+        ImGui::CheckboxFlags("Weld vertices", mesh_optimization, static_cast<unsigned int>(MeshOptimization::remap));
+        ImGui::CheckboxFlags("Optimize vertex cache", mesh_optimization, static_cast<unsigned int>(MeshOptimization::vertex_cache));
+        ImGui::CheckboxFlags("Optimize overdraw", mesh_optimization, static_cast<unsigned int>(MeshOptimization::overdraw));
+        ImGui::CheckboxFlags("Optimize vertex fetch", mesh_optimization, static_cast<unsigned int>(MeshOptimization::vertex_fetch));
+        ImGui::Checkbox("Build meshlet LODs", &m_import_settings.meshlet_lods);
+        ImGui::Checkbox("Stream geometry", &m_stream_geometry);
+        ImGui::SliderInt("Streaming pool MiB", &m_streaming_pool_mib, 64, 4096);
+        constexpr std::array<const char*, 3> meshlet_builders{ "Scan (raster)", "Flex", "Spatial (culling)" };
+        ImGui::Combo("Meshlet builder", reinterpret_cast<int*>(&m_import_settings.meshlets.builder), meshlet_builders.data(), meshlet_builders.size());
+
+        ImGui::BeginDisabled(is_loading());
         if (ImGui::Button("Load Scene", ImVec2(120, 0)))
         {
             if (!m_scene_files.empty())
             {
-                load_scene(std::filesystem::path(m_scene_files[selectedSceneIndex]));
+                load_scene_async(std::filesystem::path(m_scene_files[selectedSceneIndex]));
             }
         }
+        ImGui::EndDisabled();
+        if (m_scene_load)
+        {
+            constexpr std::array<const char*, 5> load_stages{ "Importing", "Uploading", "Submitting", "Finishing upload", "Failed" };
+            ImGui::Text("%s %s", load_stages[static_cast<int>(m_scene_load->stage.load())], m_scene_load->path.filename().string().c_str());
+            ImGui::ProgressBar(m_scene_load->progress);
+        }
+        const StagingStats& staging_stats = m_staging_ring->get_stats();
+        ImGui::Text("Staged: %llu MiB in %llu copies, %llu stalls", staging_stats.bytes.load() >> 20, staging_stats.allocations.load(), staging_stats.stalls.load());
+        ImGui::Text("Buffer pool blocks: %zu device, %zu host", m_context.allocator->get_device_pool().get_block_count(), m_context.allocator->get_host_pool().get_block_count());
 
         ImGui::Separator();
 
@@ -489,6 +799,18 @@ void pvp::PvpScene::update()
         ImGui::Separator();
 
         ImGui::Text("MESH_SHADER_INVOCATIONS: %llu", m_invocation_count);
+        ImGui::Text("CPU visible instances: %zu / %zu", m_visible_instances.size(), m_gpu_scene->instances.size());
+        if (m_gpu_scene->streamer)
+        {
+            ImGui::Text("Resident models: %u / %zu", m_gpu_scene->streamer->get_resident_count(), m_gpu_scene->models.size());
+            ImGui::Text("Streaming pool: %llu / %llu MiB", m_gpu_scene->streamer->get_resident_bytes() >> 20, m_gpu_scene->streamer->get_pool_size() >> 20);
+            const StagingRing& streaming_staging = m_gpu_scene->streamer->get_staging();
+            ImGui::Text("Streaming staging: %llu / %llu MiB, %llu stalled frames",
+                        streaming_staging.get_used() >> 20,
+                        streaming_staging.get_size() >> 20,
+                        m_gpu_scene->streamer->get_staging_stalls());
+            ImGui::Checkbox("Show streaming placeholders", &m_show_streaming_placeholders);
+        }
 
         ImGui::Separator();
         ImGui::Text("Debug rendering");
@@ -502,6 +824,8 @@ void pvp::PvpScene::update()
 
         constexpr std::array<const char*, 4> cull_modes{ "none", "backface", "backface + radar", "backface + cone" };
         ImGui::Combo("CullMode", reinterpret_cast<int*>(&m_cull_mode), cull_modes.data(), cull_modes.size());
+        ImGui::Checkbox("LOD", &m_lod_enabled);
+        ImGui::SliderFloat("LOD pixel error", &m_lod_pixel_error, 0.25f, 16.0f);
 
         ImGui::Separator();
         ImGui::Text("Meshlet render settings:");
@@ -513,6 +837,18 @@ void pvp::PvpScene::update()
     ImGui::End();
 }
 
+void pvp::PvpScene::record_transfers(const FrameContext& frame_context, std::vector<SubmitTicket>& frame_waits)
+{
+    if (m_scene_load && m_scene_load->stage == SceneLoadStage::submitted)
+    {
+        frame_waits.push_back(m_scene_load->ticket);
+    }
+    if (m_gpu_scene->streamer)
+    {
+        m_gpu_scene->streamer->record(frame_context.command_buffer, frame_context.buffer_index);
+    }
+}
+
 void pvp::PvpScene::update_render(const FrameContext& frame_context)
 {
     auto& commands_buffer = m_command_queue[frame_context.buffer_index];
@@ -530,131 +866,59 @@ void pvp::PvpScene::update_render(const FrameContext& frame_context)
 
     m_scene_globals_gpu.update(frame_context.buffer_index, m_scene_globals);
 }
-void pvp::PvpScene::generate_mipmaps(VkCommandBuffer cmd, StaticImage& gpu_image, uint32_t width, uint32_t height)
-{
-    for (uint32_t i = 1; i < gpu_image.get_mipmap_levels(); ++i)
-    {
-        VkImageBlit2 region{
-            .sType = VK_STRUCTURE_TYPE_IMAGE_BLIT_2,
-            .srcSubresource = VkImageSubresourceLayers{
-                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                .mipLevel = i - 1,
-                .baseArrayLayer = 0,
-                .layerCount = 1 },
-            .srcOffsets = { VkOffset3D{ 0, 0, 0 }, VkOffset3D{ static_cast<int32_t>(width >> (i - 1)), static_cast<int32_t>(height >> (i - 1)), 1 } },
-            .dstSubresource = VkImageSubresourceLayers{ .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = i, .baseArrayLayer = 0, .layerCount = 1 },
-            .dstOffsets = { VkOffset3D{ 0, 0, 0 }, VkOffset3D{ static_cast<int32_t>(width >> i), static_cast<int32_t>(height >> i), 1 } },
-        };
-
-        const VkBlitImageInfo2 info{
-            .sType = VK_STRUCTURE_TYPE_BLIT_IMAGE_INFO_2,
-            .srcImage = gpu_image.get_image(),
-            .srcImageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-            .dstImage = gpu_image.get_image(),
-            .dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            .regionCount = 1,
-            .pRegions = &region,
-            .filter = VK_FILTER_NEAREST
-        };
-
-        VkImageSubresourceRange range{
-            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-            .baseMipLevel = i,
-            .levelCount = 1,
-            .baseArrayLayer = 0,
-            .layerCount = 1
-        };
-
-        gpu_image.transition_layout_range(cmd,
-                                          VK_IMAGE_LAYOUT_UNDEFINED,
-                                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                          VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT,
-                                          VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                                          VK_ACCESS_2_NONE,
-                                          VK_ACCESS_2_TRANSFER_WRITE_BIT,
-                                          range);
-        vkCmdBlitImage2(cmd, &info);
-
-        gpu_image.transition_layout_range(cmd,
-                                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                          VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                                          VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                                          VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                                          VK_ACCESS_2_TRANSFER_WRITE_BIT,
-                                          VK_ACCESS_2_TRANSFER_READ_BIT,
-                                          range);
-    }
-}
-void pvp::PvpScene::load_textures(const LoadedScene& loaded_scene, DestructorQueue& transfer_deleter, VkCommandBuffer cmd)
+void pvp::PvpScene::load_textures(GpuScene& scene, const CachedScene& loaded_scene, StagingUploader& uploader)
 {
     ZoneScoped;
-    m_gpu_textures.reserve(m_gpu_textures.size() + loaded_scene.textures.size());
+    scene.textures.reserve(scene.textures.size() + loaded_scene.textures.size());
 
-    for (const TextureData& texture : loaded_scene.textures)
+    for (const CachedTexture& texture : loaded_scene.textures)
     {
         ZoneScopedN("Texture");
-        ZoneTextF(texture.name.c_str());
-        // VkDeviceSize image_size = texture.width * texture.height * texture.channels;
-
-        Buffer staging_buffer{};
-        BufferBuilder()
-            .set_size(texture.pixels.size() * sizeof(uint8_t))
-            .set_usage(VK_BUFFER_USAGE_TRANSFER_SRC_BIT)
-            .set_flags(VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT)
-            .build(m_context.allocator->get_allocator(), staging_buffer);
-
-        transfer_deleter.add_to_queue([=] { staging_buffer.destroy(); });
-        staging_buffer.copy_data_into_buffer(std::span(texture.pixels));
+        ZoneText(texture.name.data(), texture.name.size());
 
         StaticImage gpu_image;
         ImageBuilder()
-            .set_name(texture.name)
+            .set_name(std::string(texture.name))
             .set_format(texture.format)
-            .set_usage(VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT)
+            .set_usage(VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT)
             .set_size({ .width = texture.width, .height = texture.height })
             .set_memory_usage(VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE)
             .set_aspect_flags(VK_IMAGE_ASPECT_COLOR_BIT)
-            .set_use_mipmap(texture.generate_mip_maps)
+            .set_mip_levels(static_cast<uint32_t>(texture.levels.size()))
+            .set_swizzle(texture.swizzle)
             .build(m_context, gpu_image);
 
-        gpu_image.transition_layout(cmd,
+        gpu_image.transition_layout(uploader.get_command_buffer(),
                                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                                     VK_PIPELINE_STAGE_2_NONE,
                                     VK_PIPELINE_STAGE_2_TRANSFER_BIT,
                                     VK_ACCESS_2_NONE,
                                     VK_ACCESS_2_TRANSFER_WRITE_BIT);
-        gpu_image.copy_from_buffer(cmd, staging_buffer);
-        gpu_image.transition_layout(cmd,
-                                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                                    VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                                    VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                                    VK_ACCESS_2_TRANSFER_WRITE_BIT,
-                                    VK_ACCESS_2_TRANSFER_READ_BIT);
-        generate_mipmaps(cmd, gpu_image, texture.width, texture.height);
-        gpu_image.transition_layout(cmd,
+
+        // The whole mip chain was built at import time, BCn levels are split on 4x4 block rows when they don't fit at once
+        std::vector<ImageUploadLevel> levels;
+        levels.reserve(texture.levels.size());
+        for (const TextureLevel& level : texture.levels)
+        {
+            levels.push_back(ImageUploadLevel{ level.offset, level.size, level.width, level.height });
+        }
+        const bool block_compressed = texture.format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && texture.format <= VK_FORMAT_BC7_SRGB_BLOCK;
+        uploader.upload_image(std::as_bytes(texture.pixels), gpu_image.get_image(), levels, block_compressed ? 4 : 1);
+
+        gpu_image.transition_layout(uploader.get_command_buffer(),
                                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
                                     VK_PIPELINE_STAGE_2_TRANSFER_BIT,
                                     VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
-                                    VK_ACCESS_2_TRANSFER_READ_BIT,
+                                    VK_ACCESS_2_TRANSFER_WRITE_BIT,
                                     VK_ACCESS_2_SHADER_READ_BIT);
 
-        m_gpu_textures.push_back(std::move(gpu_image));
+        scene.textures.push_back(std::move(gpu_image));
     }
 }
 
-void pvp::PvpScene::load_default_textures(DestructorQueue& transfer_deleter, VkCommandBuffer cmd)
+void pvp::PvpScene::load_default_textures(GpuScene& scene, StagingUploader& uploader)
 {
     auto create_default_texture = [&](const std::array<uint8_t, 4>& data, const std::string& name) {
-        Buffer staging_buffer{};
-        BufferBuilder()
-            .set_size(4 * sizeof(uint8_t))
-            .set_usage(VK_BUFFER_USAGE_TRANSFER_SRC_BIT)
-            .set_flags(VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT)
-            .build(m_context.allocator->get_allocator(), staging_buffer);
-
-        transfer_deleter.add_to_queue([=] { staging_buffer.destroy(); });
-        staging_buffer.copy_data_into_buffer(std::span(data.cbegin(), data.cend()));
-
         StaticImage gpu_image;
         ImageBuilder()
             .set_name(name.c_str())
@@ -666,21 +930,22 @@ void pvp::PvpScene::load_default_textures(DestructorQueue& transfer_deleter, VkC
             .set_use_mipmap(false)
             .build(m_context, gpu_image);
 
-        gpu_image.transition_layout(cmd,
+        gpu_image.transition_layout(uploader.get_command_buffer(),
                                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                                     VK_PIPELINE_STAGE_2_NONE,
                                     VK_PIPELINE_STAGE_2_TRANSFER_BIT,
                                     VK_ACCESS_2_NONE,
                                     VK_ACCESS_2_TRANSFER_WRITE_BIT);
-        gpu_image.copy_from_buffer(cmd, staging_buffer);
-        gpu_image.transition_layout(cmd,
+        const std::array level{ ImageUploadLevel{ 0, data.size(), 1, 1 } };
+        uploader.upload_image(std::as_bytes(std::span(data)), gpu_image.get_image(), level);
+        gpu_image.transition_layout(uploader.get_command_buffer(),
                                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
                                     VK_PIPELINE_STAGE_2_TRANSFER_BIT,
                                     VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
                                     VK_ACCESS_2_TRANSFER_READ_BIT,
                                     VK_ACCESS_2_SHADER_READ_BIT);
 
-        m_gpu_textures.push_back(std::move(gpu_image));
+        scene.textures.push_back(std::move(gpu_image));
     };
 
     create_default_texture({ 0u, 0u, 0u, 255u }, "Default: Black");
@@ -688,174 +953,278 @@ void pvp::PvpScene::load_default_textures(DestructorQueue& transfer_deleter, VkC
     create_default_texture({ 128u, 128u, 255u, 255u }, "Default: normal");
 }
 
-void pvp::PvpScene::big_buffer_generation(const LoadedScene& loaded_scene, DestructorQueue& transfer_deleter, VkCommandBuffer cmd)
+// Every model goes into one buffer per stream, Model keeps where its sections start. Meshlet vertices and triangles
+// stay in the CompactMeshlets encoding with model local offsets, the shaders add the model's offsets on top
+void pvp::PvpScene::upload_geometry(GpuScene& scene, const CachedScene& loaded_scene, StagingUploader& uploader)
 {
     ZoneScoped;
-    auto load_data_into_big_buffer = [&](auto ModelData::* member_ptr, Buffer& buffer) {
-        using VectorType = std::decay_t<decltype(std::declval<ModelData>().*member_ptr)>::value_type;
-
-        uint32_t const total_count = std::accumulate(
-            loaded_scene.models.cbegin(),
-            loaded_scene.models.cend(),
-            0u,
-            [member_ptr](uint32_t start, const ModelData& model) {
-                return static_cast<uint32_t>(start + (model.*member_ptr).size());
-            });
-
-        BufferBuilder()
-            .set_size(total_count * sizeof(VectorType))
-            .set_usage(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT)
-            .set_memory_usage(VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE)
-            .build(m_context.allocator->get_allocator(), buffer);
-        m_scene_destructor_queue.add_to_queue([buffer] { buffer.destroy(); });
-
-        std::vector<VectorType> all_data;
-        all_data.reserve(total_count);
+    std::vector<size_t> model_indices(loaded_scene.models.size());
+    std::iota(model_indices.begin(), model_indices.end(), 0);
+    std::vector<CompactMeshlets> compacts(loaded_scene.models.size());
+    std::for_each(std::execution::par, model_indices.cbegin(), model_indices.cend(), [&](size_t i) {
+        compacts[i] = compact_meshlets(loaded_scene.models[i]);
+    });
+
+    VkDeviceSize vertex_bytes{};
+    uint32_t     index_count{};
+    uint32_t     meshlet_count{};
+    uint32_t     meshlet_vertex_count{};
+    uint32_t     triangle_count{};
+    for (size_t i = 0; i < loaded_scene.models.size(); ++i)
+    {
+        const CachedModel& cpu_model = loaded_scene.models[i];
+        Model&             model = scene.models[i];
+
+        vertex_bytes = (vertex_bytes + geometry_alignment - 1) / geometry_alignment * geometry_alignment;
+        model.vertex_offset = vertex_bytes;
+        vertex_bytes += cpu_model.vertex_bytes().size_bytes();
+        model.index_offset = index_count * sizeof(uint32_t);
+        index_count += static_cast<uint32_t>(cpu_model.indices.size());
+
+        model.meshlet_offset = meshlet_count;
+        meshlet_count += model.lod_meshlet_count;
+        model.meshlet_vertices_offset = (meshlet_vertex_count + 1) & ~1u;
+        meshlet_vertex_count = model.meshlet_vertices_offset + static_cast<uint32_t>(compacts[i].vertices.size());
+        model.meshlet_triangles_offset = (triangle_count + 1) & ~1u;
+        triangle_count = model.meshlet_triangles_offset + static_cast<uint32_t>(compacts[i].triangles.size());
+    }
 
-        for (const ModelData& model : loaded_scene.models)
+    auto create_buffer = [&](VkDeviceSize size, VkBufferUsageFlags usage, Buffer& buffer, const std::string& name) {
+        BufferBuilder builder;
+        builder.set_size(std::max(size, geometry_alignment))
+            .set_usage(usage | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT)
+            .set_memory_usage(VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE);
+        // Vertices and indices are bound by handle and model offset in the CPU passes, so they keep buffers of their own.
+        // The rest is only reached through descriptors and addresses, small scenes put it in the shared pool
+        if ((usage & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT)) == 0)
         {
-            for (const auto& element : (model.*member_ptr))
-            {
-                all_data.push_back(element);
-            }
+            builder.set_pool(m_context.allocator->get_device_pool());
+        }
+        builder.build(m_context.allocator->get_allocator(), buffer);
+        scene.destructor_queue.add_to_queue([&buffer] { buffer.destroy(); });
+        if (!buffer.is_pooled())
+        {
+            debugger::add_object_name(m_context.device, buffer.get_buffer(), name);
         }
-
-        buffer.copy_data_from_tmp_buffer(m_context, cmd, std::span(all_data), transfer_deleter);
     };
-
-    load_data_into_big_buffer(&ModelData::vertices, m_gpu_vertices);
-    // load_data_into_big_buffer(&ModelData::indices, m_gpu_indices);
-
-    // load_data_into_big_buffer(&ModelData::meshlet_vertices, m_gpu_meshlets_vertices);
-    load_data_into_big_buffer(&ModelData::meshlet_triangles, m_gpu_meshlets_triangles);
-    load_data_into_big_buffer(&ModelData::meshlet_sphere_bounds, m_gpu_meshlets_sphere_bounds);
-
-    // load_data_into_big_buffer(&ModelData::meshlets, m_gpu_meshlets);
-
-    // Generate vertex indices
+    create_buffer(vertex_bytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, scene.vertices, "Scene vertices");
+    create_buffer(index_count * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, scene.indices, "Scene indices");
+    create_buffer(meshlet_count * sizeof(GpuMeshlet), 0, scene.meshlets, "Scene meshlets");
+    create_buffer(meshlet_vertex_count * sizeof(uint32_t), 0, scene.meshlets_vertices, "Scene meshlet vertices");
+    create_buffer(triangle_count * sizeof(uint32_t), 0, scene.meshlets_triangles, "Scene meshlet triangles");
+    create_buffer(meshlet_count * sizeof(ConeBounds), 0, scene.meshlets_sphere_bounds, "Scene meshlet sphere bounds");
+    create_buffer(meshlet_count * sizeof(MeshletLod), 0, scene.meshlets_lods, "Scene meshlet lods");
+    create_buffer(loaded_scene.models.size() * sizeof(ModelGeometry), 0, scene.geometry, "Scene model geometry");
+
+    std::vector<ModelGeometry> geometry(loaded_scene.models.size());
+    for (size_t i = 0; i < loaded_scene.models.size(); ++i)
     {
-        uint32_t const total_count = std::accumulate(
-            loaded_scene.models.cbegin(),
-            loaded_scene.models.cend(),
-            0u,
-            [](uint32_t start, const ModelData& model) {
-                return static_cast<uint32_t>(start + model.meshlet_vertices.size());
-            });
-
-        BufferBuilder()
-            .set_size(total_count * sizeof(uint32_t))
-            .set_usage(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT)
-            .set_memory_usage(VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE)
-            .build(m_context.allocator->get_allocator(), m_gpu_meshlets_vertices);
-        m_scene_destructor_queue.add_to_queue([&] { m_gpu_meshlets_vertices.destroy(); });
-
-        std::vector<uint32_t> all_data;
-        all_data.reserve(total_count);
+        const CachedModel& cpu_model = loaded_scene.models[i];
+        Model&             model = scene.models[i];
+        model.vertex_buffer = scene.vertices.get_buffer();
+        model.index_buffer = scene.indices.get_buffer();
+
+        uploader.upload(cpu_model.vertex_bytes(), scene.vertices, model.vertex_offset);
+        uploader.upload(std::span<const uint32_t>(cpu_model.indices), scene.indices, model.index_offset);
+        uploader.upload(std::span<const GpuMeshlet>(compacts[i].meshlets), scene.meshlets, model.meshlet_offset * sizeof(GpuMeshlet));
+        uploader.upload(std::span<const uint32_t>(compacts[i].vertices), scene.meshlets_vertices, model.meshlet_vertices_offset * sizeof(uint32_t));
+        uploader.upload(std::span<const uint32_t>(compacts[i].triangles), scene.meshlets_triangles, model.meshlet_triangles_offset * sizeof(uint32_t));
+        uploader.upload(std::span<const ConeBounds>(cpu_model.meshlet_sphere_bounds), scene.meshlets_sphere_bounds, model.meshlet_offset * sizeof(ConeBounds));
+        uploader.upload(std::span<const MeshletLod>(cpu_model.meshlet_lods), scene.meshlets_lods, model.meshlet_offset * sizeof(MeshletLod));
+        compacts[i] = {};
+
+        geometry[i] = ModelGeometry{
+            .vertex_offset = static_cast<uint32_t>(model.vertex_offset / sizeof(uint32_t)),
+            .meshlet_offset = model.meshlet_offset,
+            .meshlet_vertices_offset = model.meshlet_vertices_offset,
+            .triangle_offset = model.meshlet_triangles_offset,
+            .meshlet_count = model.meshlet_count,
+        };
+    }
+    uploader.upload(std::span<const ModelGeometry>(geometry), scene.geometry);
+}
 
-        uint32_t meshlet_vertex_global_count{};
-        for (int i = 0; i < loaded_scene.models.size(); ++i)
-        {
-            for (int j = 0; j < loaded_scene.models[i].meshlet_vertices.size(); ++j)
-            {
-                all_data.push_back(meshlet_vertex_global_count + loaded_scene.models[i].meshlet_vertices[j]);
-            }
-            meshlet_vertex_global_count += loaded_scene.models[i].vertices.size();
-        }
+void pvp::PvpScene::build_draw_calls(GpuScene& scene)
+{
+    ZoneScoped;
+    const std::vector<Model>&    models = scene.models;
+    const std::vector<Instance>& instances = scene.instances;
 
-        m_gpu_meshlets_vertices.copy_data_from_tmp_buffer(m_context, cmd, std::span(all_data), transfer_deleter);
-    }
-    // Generate meshlets offsets
+    if (scene.streamer)
     {
-        uint32_t const total_count = std::accumulate(
-            loaded_scene.models.cbegin(),
-            loaded_scene.models.cend(),
-            0u,
-            [](uint32_t start, const ModelData& model) {
-                return static_cast<uint32_t>(start + (model.meshlets).size());
-            });
-
-        BufferBuilder()
-            .set_size(total_count * sizeof(meshopt_Meshlet))
-            .set_usage(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT)
+        // Rewritten whenever residency changes, through copies ordered after the frames still reading them
+        BufferBuilder{}
+            .set_size(sizeof(DrawCommandIndirect) * instances.size())
             .set_memory_usage(VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE)
-            .build(m_context.allocator->get_allocator(), m_gpu_meshlets);
-        m_scene_destructor_queue.add_to_queue([&] { m_gpu_meshlets.destroy(); });
-
-        std::vector<meshopt_Meshlet> all_data;
-        all_data.reserve(total_count);
-
-        uint32_t triangle_global_count{};
-        uint32_t vertex_global_count{};
-        for (int i = 0; i < loaded_scene.models.size(); ++i)
-        {
-            for (int j = 0; j < loaded_scene.models[i].meshlets.size(); ++j)
-            {
-                all_data.emplace_back(vertex_global_count,
-                                      triangle_global_count,
-                                      loaded_scene.models[i].meshlets[j].vertex_count,
-                                      loaded_scene.models[i].meshlets[j].triangle_count);
+            .set_usage(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT)
+            .set_pool(m_context.allocator->get_device_pool())
+            .build(m_context.allocator->get_allocator(), scene.indirect_draw_calls);
+        scene.destructor_queue.add_to_queue([&scene] { scene.indirect_draw_calls.destroy(); });
 
-                vertex_global_count += loaded_scene.models[i].meshlets[j].vertex_count;
-                triangle_global_count += loaded_scene.models[i].meshlets[j].triangle_count * 3;
-            }
-        }
+        BufferBuilder{}
+            .set_size(sizeof(MeshletsBuffers) * models.size())
+            .set_memory_usage(VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE)
+            .set_usage(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT)
+            .set_pool(m_context.allocator->get_device_pool())
+            .build(m_context.allocator->get_allocator(), scene.pointers);
+        scene.destructor_queue.add_to_queue([&scene] { scene.pointers.destroy(); });
 
-        m_gpu_meshlets.copy_data_from_tmp_buffer(m_context, cmd, std::span(all_data), transfer_deleter);
+        write_streamed_draw_calls(scene);
+        return;
     }
-}
 
-void pvp::PvpScene::build_draw_calls()
-{
-    ZoneScoped;
-    const std::vector<Model>& models = get_models();
     BufferBuilder{}
-        .set_size(sizeof(DrawCommandIndirect) * models.size())
+        .set_size(sizeof(DrawCommandIndirect) * instances.size())
         .set_memory_usage(VMA_MEMORY_USAGE_AUTO)
         .set_usage(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT)
         .set_flags(VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT)
-        .build(m_context.allocator->get_allocator(), m_gpu_indirect_draw_calls);
-    m_scene_destructor_queue.add_to_queue([&] { m_gpu_indirect_draw_calls.destroy(); });
+        .set_pool(m_context.allocator->get_host_pool())
+        .build(m_context.allocator->get_allocator(), scene.indirect_draw_calls);
+    scene.destructor_queue.add_to_queue([&scene] { scene.indirect_draw_calls.destroy(); });
 
-    DrawCommandIndirect* buffer_array = static_cast<DrawCommandIndirect*>(m_gpu_indirect_draw_calls.get_allocation_info().pMappedData);
-    uint32_t             meshlet_offset{};
-    for (int i = 0; i < models.size(); ++i)
+    DrawCommandIndirect* buffer_array = static_cast<DrawCommandIndirect*>(scene.indirect_draw_calls.get_allocation_info().pMappedData);
+    for (int i = 0; i < instances.size(); ++i)
     {
-        uint32_t thread_group_count_x = models[i].meshlet_count / mesh_let_count + 1;
+        const Model& model = models[instances[i].model_index];
+        uint32_t     thread_group_count_x = model.lod_meshlet_count / mesh_let_count + 1;
         buffer_array[i] = DrawCommandIndirect{
             thread_group_count_x,
             1,
             1,
-            meshlet_offset,
-            models[i].meshlet_count
+            model.meshlet_offset,
+            model.meshlet_count,
+            instances[i].model_index,
+            model.lod_meshlet_count
         };
-        meshlet_offset += models[i].meshlet_count;
     }
+    scene.indirect_draw_calls.flush(0, sizeof(DrawCommandIndirect) * instances.size());
 
     BufferBuilder{}
         .set_size(sizeof(MeshletsBuffers) * models.size())
         .set_flags(VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT)
         .set_memory_usage(VMA_MEMORY_USAGE_AUTO_PREFER_HOST)
         .set_usage(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
-        .build(m_context.allocator->get_allocator(), m_pointers);
+        .set_pool(m_context.allocator->get_host_pool())
+        .build(m_context.allocator->get_allocator(), scene.pointers);
 
-    auto get_address = [&](VkBuffer buffer) -> VkDeviceAddress {
-        VkBufferDeviceAddressInfo address_info{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO_KHR, .pNext = nullptr, .buffer = buffer };
-        return vkGetBufferDeviceAddress(m_context.device->get_device(), &address_info);
-    };
+    const VkDeviceAddress vertices = scene.vertices.get_device_address();
+    const VkDeviceAddress meshlets = scene.meshlets.get_device_address();
+    const VkDeviceAddress meshlets_vertices = scene.meshlets_vertices.get_device_address();
+    const VkDeviceAddress meshlets_triangles = scene.meshlets_triangles.get_device_address();
+    const VkDeviceAddress meshlets_sphere_bounds = scene.meshlets_sphere_bounds.get_device_address();
+    const VkDeviceAddress meshlets_lods = scene.meshlets_lods.get_device_address();
 
+    // Each model's ranges of the scene wide buffers
     for (int i = 0; i < models.size(); ++i)
     {
-        static_cast<MeshletsBuffers*>(m_pointers.get_allocation_info().pMappedData)[i] =
+        const Model& model = models[i];
+        static_cast<MeshletsBuffers*>(scene.pointers.get_allocation_info().pMappedData)[i] =
             MeshletsBuffers{
-                .vertex_data = get_address(models[i].vertex_data.get_buffer()),
-                .meshlet_data = get_address(models[i].meshlet_buffer.get_buffer()),
-                .meshlet_vertices_data = get_address(models[i].meshlet_vertices_buffer.get_buffer()),
-                .meshlet_triangle_data = get_address(models[i].meshlet_triangles_buffer.get_buffer()),
-                .meshlet_sphere_bounds_data = get_address(models[i].meshlet_sphere_bounds_buffer.get_buffer()),
+                .vertex_data = vertices + model.vertex_offset,
+                .meshlet_data = meshlets + model.meshlet_offset * sizeof(GpuMeshlet),
+                .meshlet_vertices_data = meshlets_vertices + model.meshlet_vertices_offset * sizeof(uint32_t),
+                .meshlet_triangle_data = meshlets_triangles + model.meshlet_triangles_offset * sizeof(uint32_t),
+                .meshlet_sphere_bounds_data = meshlets_sphere_bounds + model.meshlet_offset * sizeof(ConeBounds),
+                .meshlet_lod_data = meshlets_lods + model.meshlet_offset * sizeof(MeshletLod),
             };
     }
 
-    vmaFlushAllocation(m_context.allocator->get_allocator(), m_pointers.get_allocation(), 0, sizeof(MeshletsBuffers) * models.size());
+    scene.pointers.flush(0, sizeof(MeshletsBuffers) * models.size());
+
+    scene.destructor_queue.add_to_queue([&scene] { scene.pointers.destroy(); });
+}
 
-    m_scene_destructor_queue.add_to_queue([&] { m_pointers.destroy(); });
+// Instances of models that are not resident keep their slot with zero task groups, so gl_DrawID still finds their matrix
+void pvp::PvpScene::write_streamed_draw_calls(GpuScene& scene)
+{
+    ZoneScoped;
+    std::vector<DrawCommandIndirect> draw_calls(scene.instances.size());
+    for (size_t i = 0; i < scene.instances.size(); ++i)
+    {
+        const uint32_t model_index = scene.instances[i].model_index;
+        const Model&   model = scene.models[model_index];
+        draw_calls[i] = DrawCommandIndirect{
+            model.resident ? model.lod_meshlet_count / mesh_let_count + 1 : 0,
+            1,
+            1,
+            model.meshlet_offset,
+            model.meshlet_count,
+            model_index,
+            model.lod_meshlet_count
+        };
+    }
+
+    const std::span<const StreamedModel> streamed = scene.streamer->get_models();
+    const VkDeviceAddress                pool = scene.streamer->get_pool_address();
+    std::vector<MeshletsBuffers>         pointers(scene.models.size());
+    for (size_t i = 0; i < streamed.size(); ++i)
+    {
+        if (!streamed[i].is_resident())
+        {
+            continue;
+        }
+        pointers[i] = MeshletsBuffers{
+            .vertex_data = pool + streamed[i].vertex_offset,
+            .meshlet_data = pool + streamed[i].meshlet_offset,
+            .meshlet_vertices_data = pool + streamed[i].meshlet_vertices_offset,
+            .meshlet_triangle_data = pool + streamed[i].meshlet_triangles_offset,
+            .meshlet_sphere_bounds_data = pool + streamed[i].meshlet_sphere_bounds_offset,
+            .meshlet_lod_data = pool + streamed[i].meshlet_lod_offset,
+        };
+    }
+
+    scene.streamer->stage(std::span<const DrawCommandIndirect>(draw_calls), scene.indirect_draw_calls);
+    scene.streamer->stage(std::span<const MeshletsBuffers>(pointers), scene.pointers);
+}
+
+// Models are wanted by how large their nearest visible instance is on screen, the instances closest to the camera are
+// kept around at a lower priority so turning around doesn't start from nothing
+void pvp::PvpScene::update_streaming()
+{
+    ZoneScoped;
+    const glm::vec3 camera_position = m_camera.get_position();
+    const float     near_plane = m_scene_globals.radar_cull_data.near_plane;
+    auto            request = [&](uint32_t instance, float weight) {
+        const Aabb& bounds = m_gpu_scene->instance_bounds[instance];
+        const float radius = glm::length(bounds.max - bounds.min) * 0.5f;
+        const float distance = std::max(glm::distance(camera_position, bounds.center()) - radius, near_plane);
+        m_gpu_scene->streamer->request(m_gpu_scene->instances[instance].model_index, weight * radius / distance);
+    };
+
+    for (const uint32_t instance : m_visible_instances)
+    {
+        request(instance, 1.0f);
+    }
+    m_gpu_scene->bvh.query_nearest(camera_position, streaming_prefetch_count, m_streaming_nearest);
+    for (const uint32_t instance : m_streaming_nearest)
+    {
+        request(instance, 0.5f);
+    }
+
+    if (m_gpu_scene->streamer->update())
+    {
+        const std::span<const StreamedModel> streamed = m_gpu_scene->streamer->get_models();
+        for (size_t i = 0; i < streamed.size(); ++i)
+        {
+            Model& model = m_gpu_scene->models[i];
+            model.resident = streamed[i].is_resident();
+            model.vertex_buffer = m_gpu_scene->streamer->get_pool().get_buffer();
+            model.vertex_offset = streamed[i].vertex_offset;
+            model.index_buffer = m_gpu_scene->streamer->get_pool().get_buffer();
+            model.index_offset = streamed[i].index_offset;
+        }
+        write_streamed_draw_calls(*m_gpu_scene);
+    }
+
+    if (m_show_streaming_placeholders)
+    {
+        // Stand ins for what is in view but still on disk
+        for (const uint32_t instance : m_visible_instances)
+        {
+            if (!m_gpu_scene->models[m_gpu_scene->instances[instance].model_index].resident)
+            {
+                gizmos::draw_box(m_gpu_scene->instance_bounds[instance].min, m_gpu_scene->instance_bounds[instance].max, { 1.0f, 0.5f, 0.0f, 1.0f });
+            }
+        }
+    }
 }
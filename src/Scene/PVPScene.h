@@ -1,16 +1,28 @@
 ﻿#pragma once
 #include "Camera.h"
+#include "GeometryStreamer.h"
+#include "LodSelection.h"
 #include "ModelData.h"
+#include "SceneBvh.h"
 
 #include <DestructorQueue.h>
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
 #include <deque>
 #include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <Buffer/Buffer.h>
+#include <Buffer/StagingRing.h>
+#include <Buffer/StagingUploader.h>
+#include <CommandBuffer/CommandPool.h>
 #include <Context/Context.h>
 #include <Context/Device.h>
 #include <DescriptorSets/DescriptorSets.h>
+#include <GraphicsPipeline/ShaderLoader.h>
 #include <Image/Sampler.h>
 #include <Image/StaticImage.h>
 #include <UniformBuffers/UniformBuffer.h>
@@ -21,6 +33,7 @@ namespace pvp
 {
     struct Sampler;
 
+    // Matches ModelInfo in shared_structs.glsl
     struct alignas(8) MaterialTransform
     {
         glm::mat4x4 transform;
@@ -28,7 +41,14 @@ namespace pvp
         uint32_t    normal_texture_index;
         uint32_t    metalness_texture_index;
         bool        normal_decompression;
+
+        // Dequantizes PackedVertex positions. Identity for VertexFormat::full
+        alignas(16) glm::vec3 position_offset{ 0.0f };
+        VertexFormat          vertex_format{ VertexFormat::full };
+        alignas(16) glm::vec3 position_scale{ 1.0f };
     };
+    static_assert(sizeof(MaterialTransform) == 112);
+    // One per Model, instances find theirs through DrawCommandIndirect::model_index
     struct alignas(8) MeshletsBuffers
     {
         VkDeviceAddress vertex_data;
@@ -36,23 +56,44 @@ namespace pvp
         VkDeviceAddress meshlet_vertices_data;
         VkDeviceAddress meshlet_triangle_data;
         VkDeviceAddress meshlet_sphere_bounds_data;
+        VkDeviceAddress meshlet_lod_data;
+    };
+    // One per Model, where its sections start in the scene wide geometry buffers. Matches ModelGeometry in shared_structs.glsl
+    struct ModelGeometry
+    {
+        uint32_t vertex_offset;           // In 32 bit words, vertices are read as words by the mesh shaders
+        uint32_t meshlet_offset;          // Also the first sphere bounds and lod
+        uint32_t meshlet_vertices_offset; // In uints of the CompactMeshlets encoding
+        uint32_t triangle_offset;         // Same
+        uint32_t meshlet_count;           // Full detail
     };
 
+    // Geometry shared by every instance drawing it. The data itself lives in the scene wide buffers of GpuScene
     struct Model
     {
-        Buffer            vertex_data;
-        Buffer            index_data;
-        uint32_t          index_count;
-        MaterialTransform material;
+        uint32_t              index_count; // Full detail
+        std::vector<IndexLod> index_lods;
 
-        // Meshlet data
-        uint32_t       meshlet_count;
-        DescriptorSets meshlet_descriptor_set;
+        // Where the CPU passes bind vertices and indices from. The scene wide buffers, or the model's range of the streaming pool
+        VkBuffer     vertex_buffer{ VK_NULL_HANDLE };
+        VkDeviceSize vertex_offset{};
+        VkBuffer     index_buffer{ VK_NULL_HANDLE };
+        VkDeviceSize index_offset{};
+        bool         resident{ true }; // Streamed models are only drawn while their geometry is in the pool
 
-        Buffer meshlet_buffer;
-        Buffer meshlet_vertices_buffer;
-        Buffer meshlet_triangles_buffer;
-        Buffer meshlet_sphere_bounds_buffer;
+        // Meshlet data in the CompactMeshlets encoding, offsets in elements of the scene wide buffers
+        uint32_t meshlet_count;           // Full detail meshlets
+        uint32_t lod_meshlet_count;       // Full detail plus the simplified levels behind them
+        uint32_t meshlet_offset;          // First meshlet, sphere bounds and lod
+        uint32_t meshlet_vertices_offset; // Kept at even offsets so the pointer path sees 8 byte aligned addresses
+        uint32_t meshlet_triangles_offset;
+    };
+
+    // One draw of a model. Indexes MaterialTransform, DrawCommandIndirect and gl_DrawID
+    struct Instance
+    {
+        uint32_t          model_index;
+        MaterialTransform material;
     };
 
     struct SceneGlobals
@@ -64,6 +105,7 @@ namespace pvp
         alignas(16) glm::mat4x4 camera_projection_view;
         alignas(16) RadarCull radar_cull_data;
         alignas(16) int32_t culling_mode{};
+        float lod_error_scale{}; // Turns a meshlet error over its distance into pixels over the threshold. 0 draws full detail
     };
 
     struct alignas(16) PointLight
@@ -87,6 +129,8 @@ namespace pvp
         uint32_t group_count_z;
         uint32_t mesh_let_offset;
         uint32_t mesh_let_count;
+        uint32_t model_index;
+        uint32_t lod_mesh_let_count;
     };
 
     enum class RenderMode : int
@@ -108,6 +152,80 @@ namespace pvp
         backface_cone = 3u
     };
 
+    // Everything a loaded scene owns. Built off the render thread and swapped in whole, so passes never see half a scene
+    struct GpuScene
+    {
+        std::vector<Model>       models;
+        std::vector<Instance>    instances;
+        std::vector<StaticImage> textures;
+        LodSelectionInput        lod_input;
+        std::vector<Aabb>        instance_bounds;
+        SceneBvh                 bvh;
+        VertexFormat             vertex_format{ VertexFormat::full };
+
+        // Every model's geometry back to back, uploaded once and read by the CPU, indirect and pointer paths alike.
+        // Left empty for streamed scenes, their geometry lives in the streamer's pool
+        Buffer vertices;
+        Buffer indices;
+        Buffer meshlets;
+        Buffer meshlets_vertices;
+        Buffer meshlets_triangles;
+        Buffer meshlets_sphere_bounds;
+        Buffer meshlets_lods;
+        Buffer geometry; // ModelGeometry per model
+
+        Buffer matrix;
+
+        Buffer indirect_draw_calls;
+        Buffer pointers;
+
+        // Built on the render thread when the uploads are submitted, the descriptor pool is not thread safe
+        DescriptorSets all_textures;
+        DescriptorSets indirect_descriptor;
+        DescriptorSets indirect_descriptor_ptr;
+        bool           has_descriptors{};
+
+        std::unique_ptr<GeometryStreamer> streamer; // Only for scenes loaded with streaming on
+        DestructorQueue                   destructor_queue;
+    };
+
+    enum class SceneLoadStage : int
+    {
+        importing = 0,
+        uploading,
+        recorded,  // Uploads are in the command buffer, waiting for the render thread to submit them
+        submitted, // Swapped in, frames wait for the upload on the GPU until it is done
+        failed
+    };
+
+    // A scene on its way in. The worker imports and records the uploads, the render thread submits them and swaps the
+    // scene in straight away. The load lives on until the ticket is done to release the staging ring
+    struct SceneLoad
+    {
+        std::filesystem::path            path;
+        std::unique_ptr<GpuScene>        scene;
+        CommandPool                      transfer_pool;
+        std::unique_ptr<StagingUploader> uploader;
+        VkCommandBuffer                  cmd{ VK_NULL_HANDLE };
+        SubmitTicket                     ticket;
+        std::atomic<SceneLoadStage>      stage{ SceneLoadStage::importing };
+        std::atomic<float>               progress{};
+        std::thread                      worker;
+
+        // The worker hands full command buffers to the render thread when the staging ring runs out and waits for the ticket
+        std::mutex              submit_mutex;
+        std::condition_variable submit_changed;
+        VkCommandBuffer         submit_request{ VK_NULL_HANDLE };
+        SubmitTicket            submit_ticket;
+    };
+
+    // A swapped out scene, destroyed once the frames that were recorded with it are done
+    struct RetiredScene
+    {
+        std::unique_ptr<GpuScene> scene;
+        uint32_t                  frames_left;
+    };
+
     class PvpScene final
     {
     public:
@@ -116,7 +234,10 @@ namespace pvp
         DISABLE_COPY(PvpScene);
         DISABLE_MOVE(PvpScene);
 
+        // Blocks until the scene is uploaded. load_scene_async keeps the current scene up while the new one loads
         void     load_scene(const std::filesystem::path& path);
+        void     load_scene_async(const std::filesystem::path& path);
+        bool     is_loading() const;
         void     unload_scenes();
         uint32_t add_point_light(const PointLight& light);
         void     change_point_light(uint32_t light_index, const PointLight& light);
@@ -125,14 +246,40 @@ namespace pvp
 
         void update();
         void update_render(const FrameContext& frame_context);
+        // Streamed geometry and draw tables are copied here, before any pass of the frame reads them. Uploads submitted
+        // on their own that the frame has to wait for go into frame_waits
+        void record_transfers(const FrameContext& frame_context, std::vector<SubmitTicket>& frame_waits);
 
         const std::vector<Model>& get_models() const
         {
-            return m_gpu_models;
+            return m_gpu_scene->models;
         };
+        const std::vector<Instance>& get_instances() const
+        {
+            return m_gpu_scene->instances;
+        };
+        // Index level per instance for RenderMode::cpu, picked once per frame so every pass draws the same triangles
+        const std::vector<uint8_t>& get_instance_lods() const
+        {
+            return m_instance_lods;
+        }
+        // Instances RenderMode::cpu draws this frame, the ones the frozen frustum sees unless culling is off
+        const std::vector<uint32_t>& get_visible_instances() const
+        {
+            return m_visible_instances;
+        }
+        // World space box per instance, the items of get_bvh()
+        const std::vector<Aabb>& get_instance_bounds() const
+        {
+            return m_gpu_scene->instance_bounds;
+        }
+        const SceneBvh& get_bvh() const
+        {
+            return m_gpu_scene->bvh;
+        }
         const std::vector<StaticImage>& get_textures() const
         {
-            return m_gpu_textures;
+            return m_gpu_scene->textures;
         };
         const UniformBuffer& get_scene_globals() const
         {
@@ -144,7 +291,7 @@ namespace pvp
         }
         const DescriptorSets& get_textures_descriptor() const
         {
-            return m_all_textures;
+            return m_gpu_scene->all_textures;
         }
         const DescriptorSets& get_light_descriptor() const
         {
@@ -152,52 +299,69 @@ namespace pvp
         }
         const Buffer& get_all_vertex_buffer() const
         {
-            return m_gpu_vertices;
+            return m_gpu_scene->vertices;
+        }
+        const Buffer& get_all_index_buffer() const
+        {
+            return m_gpu_scene->indices;
         }
         const Buffer& get_matrix_buffer() const
         {
-            return m_gpu_matrix;
+            return m_gpu_scene->matrix;
         }
         VkDeviceAddress get_matrix_buffer_address() const
         {
-            VkBufferDeviceAddressInfo address_info{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO_KHR, .pNext = nullptr, .buffer = m_gpu_matrix.get_buffer() };
-            return vkGetBufferDeviceAddress(m_context.device->get_device(), &address_info);
+            return m_gpu_scene->matrix.get_device_address();
         }
         const Buffer& get_meshlets_buffer() const
         {
-            return m_gpu_meshlets;
+            return m_gpu_scene->meshlets;
         }
         const Buffer& get_meshlets_vertices_buffer() const
         {
-            return m_gpu_meshlets_vertices;
+            return m_gpu_scene->meshlets_vertices;
         }
         const Buffer& get_meshlets_triangles_buffer() const
         {
-            return m_gpu_meshlets_triangles;
+            return m_gpu_scene->meshlets_triangles;
         }
         const Buffer& get_meshlets_sphere_bounds_buffer() const
         {
-            return m_gpu_meshlets_sphere_bounds;
+            return m_gpu_scene->meshlets_sphere_bounds;
+        }
+        const Buffer& get_meshlets_lods_buffer() const
+        {
+            return m_gpu_scene->meshlets_lods;
+        }
+        const Buffer& get_geometry_buffer() const
+        {
+            return m_gpu_scene->geometry;
         }
         const Buffer& get_indirect_draw_calls() const
         {
-            return m_gpu_indirect_draw_calls;
+            return m_gpu_scene->indirect_draw_calls;
         }
         const DescriptorSets& get_indirect_descriptor_set() const
         {
-            return m_indirect_descriptor;
+            return m_gpu_scene->indirect_descriptor;
         }
         bool get_sphere_enabled() const
         {
-            return m_spheres_enabled;
+            // Reads the scene wide buffers streamed scenes don't have
+            return m_spheres_enabled && !m_gpu_scene->streamer;
         }
         RenderMode get_render_mode() const
         {
             return m_render_mode;
         }
+        VertexFormat get_vertex_format() const
+        {
+            return m_gpu_scene->vertex_format;
+        }
         RenderModeMeshLets get_mesh_lets_render_mode() const
         {
-            return m_render_mesh_lets_mode;
+            // Streamed geometry is only reachable through the pointer table
+            return m_gpu_scene->streamer ? RenderModeMeshLets::gpu_indirect_pointers : m_render_mesh_lets_mode;
         }
         bool get_meshlets_enabeled() const
         {
@@ -205,46 +369,54 @@ namespace pvp
         }
         const Buffer& get_pointers() const
         {
-            return m_pointers;
+            return m_gpu_scene->pointers;
         }
         const DescriptorSets& get_indirect_ptr_descriptor_set() const
         {
-            return m_indirect_descriptor_ptr;
+            return m_gpu_scene->indirect_descriptor_ptr;
+        }
+        // Mesh shaders are compiled for the meshlet limits scenes get imported with
+        std::span<const ShaderLoader::ShaderDefine> get_meshlet_defines() const
+        {
+            return m_meshlet_defines;
         }
 
     private:
-        void generate_mipmaps(VkCommandBuffer cmd, StaticImage& gpu_image, uint32_t width, uint32_t height);
-        void load_textures(const LoadedScene& scene, DestructorQueue& transfer_deleter, VkCommandBuffer cmd);
-        void load_default_textures(DestructorQueue& transfer_deleter, VkCommandBuffer cmd);
-        void big_buffer_generation(const LoadedScene& loaded_scene, DestructorQueue& transfer_deleter, VkCommandBuffer cmd);
-        void build_draw_calls();
-        void scan_folder();
-
-        Context&                 m_context;
-        std::vector<Model>       m_gpu_models;
-        std::vector<StaticImage> m_gpu_textures;
-        DescriptorSets           m_scene_binding;
-        DescriptorSets           m_all_textures;
-        DescriptorSets           m_point_descriptor;
-        Sampler                  m_shadered_sampler;
-        SceneGlobals             m_scene_globals;
-        UniformBuffer            m_point_lights_gpu;
-        UniformBuffer            m_directonal_lights_gpu;
-        UniformBuffer            m_scene_globals_gpu;
-
-        Buffer m_gpu_vertices;
-        Buffer m_gpu_matrix;
+        // Runs on the loader thread, only touches load and what it was given
+        void build_scene(SceneLoad& load, ImportSettings settings, bool streaming, VkDeviceSize pool_size);
+        void poll_scene_load(bool wait);
+        // Called by the worker when the staging ring is full, blocks until the render thread submitted cmd
+        SubmitTicket submit_scene_upload(SceneLoad& load, VkCommandBuffer cmd);
+        // Submits what the worker asked for. With wait it keeps doing so until the worker is done recording
+        void serve_scene_uploads(SceneLoad& load, bool wait);
+        void build_scene_descriptors(GpuScene& scene);
+        void destroy_gpu_scene(GpuScene& scene) const;
+        void cancel_scene_load();
 
-        Buffer m_gpu_meshlets;
-        Buffer m_gpu_meshlets_vertices;
-        Buffer m_gpu_meshlets_triangles;
-        Buffer m_gpu_meshlets_sphere_bounds;
-
-        Buffer         m_gpu_indirect_draw_calls;
-        DescriptorSets m_indirect_descriptor;
+        void load_textures(GpuScene& scene, const CachedScene& loaded_scene, StagingUploader& uploader);
+        void load_default_textures(GpuScene& scene, StagingUploader& uploader);
+        void upload_geometry(GpuScene& scene, const CachedScene& loaded_scene, StagingUploader& uploader);
+        void build_draw_calls(GpuScene& scene);
+        void write_streamed_draw_calls(GpuScene& scene);
+        void update_streaming();
+        void scan_folder();
+        void tune_meshlet_settings();
 
-        Buffer         m_pointers;
-        DescriptorSets m_indirect_descriptor_ptr;
+        Context&                     m_context;
+        std::unique_ptr<GpuScene>    m_gpu_scene; // Never null, empty until the first scene is swapped in
+        std::unique_ptr<SceneLoad>   m_scene_load;
+        std::unique_ptr<StagingRing> m_staging_ring; // Every scene upload goes through here, one load at a time
+        std::vector<RetiredScene>    m_retired_scenes;
+        std::vector<uint8_t>         m_instance_lods;
+        Frustum                      m_frustum{};
+        std::vector<uint32_t>        m_visible_instances;
+        DescriptorSets               m_scene_binding;
+        DescriptorSets               m_point_descriptor;
+        Sampler                      m_shadered_sampler;
+        SceneGlobals                 m_scene_globals;
+        UniformBuffer                m_point_lights_gpu;
+        UniformBuffer                m_directonal_lights_gpu;
+        UniformBuffer                m_scene_globals_gpu;
 
         std::vector<std::vector<std::function<void(int, PvpScene&)>>> m_command_queue;
 
@@ -257,16 +429,30 @@ namespace pvp
         RenderModeMeshLets m_render_mesh_lets_mode{ RenderModeMeshLets::gpu_indirect_pointers };
         CullMode           m_cull_mode{ CullMode::backface_radar };
         bool               m_update_frustum{ true };
+        bool               m_lod_enabled{ true };
+        float              m_lod_pixel_error{ 1.0f };
         uint64_t           m_invocation_count{};
 
-        std::vector<std::string> m_scene_files;
+        std::vector<std::string>                m_scene_files;
+        ImportSettings                          m_import_settings;
+        std::vector<ShaderLoader::ShaderDefine> m_meshlet_defines;
+        uint32_t                                m_mesh_group_size{ 128 };
+
+        bool                  m_stream_geometry{};
+        int                   m_streaming_pool_mib{ 512 };
+        bool                  m_show_streaming_placeholders{ true };
+        std::vector<uint32_t> m_streaming_nearest;
 
         float              m_result_timer{};
         float              m_result_delta_time{};
         std::vector<float> m_counted_up_delta_time;
 
-        constexpr static uint32_t max_point_lights{ 10u };
-        constexpr static uint32_t max_direction_lights{ 10u };
-        DestructorQueue           m_scene_destructor_queue;
+        constexpr static uint32_t     max_point_lights{ 10u };
+        constexpr static uint32_t     max_direction_lights{ 10u };
+        constexpr static float        lod_min_coverage{ 2.0f };               // Projected radius in pixels below which instances draw their coarsest level
+        constexpr static size_t       streaming_prefetch_count{ 64 };         // Nearest instances kept resident even when out of view
+        constexpr static uint64_t     streaming_upload_budget{ 32ull << 20 }; // Bytes paged in per frame
+        constexpr static uint64_t     staging_ring_size{ 64ull << 20 };
+        constexpr static VkDeviceSize geometry_alignment{ 16 }; // Where each model's vertices start, enough for every vertex format
     };
 } // namespace pvp
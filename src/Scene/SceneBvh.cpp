@@ -0,0 +1,315 @@
+﻿#include "SceneBvh.h"
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <queue>
+#include <utility>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+#include <glm/vector_relational.hpp>
+#include <tracy/Tracy.hpp>
+
+namespace
+{
+    float distance_squared(const pvp::Aabb& box, const glm::vec3& point)
+    {
+        const glm::vec3 outside = glm::max(glm::max(box.min - point, point - box.max), glm::vec3(0.0f));
+        return glm::dot(outside, outside);
+    }
+
+    bool intersects(const pvp::Frustum& frustum, const pvp::Aabb& box)
+    {
+        for (const glm::vec4& plane : frustum.planes)
+        {
+            // Corner furthest along the plane normal
+            const glm::vec3 corner = glm::mix(box.min, box.max, glm::greaterThanEqual(glm::vec3(plane), glm::vec3(0.0f)));
+            if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+} // namespace
+
+void pvp::Aabb::grow(const glm::vec3& point)
+{
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+void pvp::Aabb::grow(const Aabb& other)
+{
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+}
+
+pvp::Aabb pvp::Aabb::transformed(const glm::mat4& matrix) const
+{
+    if (empty())
+    {
+        return *this;
+    }
+
+    // Center moves with the matrix, the half extent with its absolute rotation and scale
+    const glm::vec3 center = glm::vec3(matrix * glm::vec4(this->center(), 1.0f));
+    const glm::vec3 half_extent = (max - min) * 0.5f;
+    const glm::vec3 new_extent = glm::abs(glm::vec3(matrix[0])) * half_extent.x +
+        glm::abs(glm::vec3(matrix[1])) * half_extent.y +
+        glm::abs(glm::vec3(matrix[2])) * half_extent.z;
+    return Aabb{ .min = center - new_extent, .max = center + new_extent };
+}
+
+glm::vec3 pvp::Aabb::center() const
+{
+    return (min + max) * 0.5f;
+}
+
+float pvp::Aabb::surface_area() const
+{
+    if (empty())
+    {
+        return 0.0f;
+    }
+    const glm::vec3 extent = max - min;
+    return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+bool pvp::Aabb::empty() const
+{
+    return min.x > max.x || min.y > max.y || min.z > max.z;
+}
+
+pvp::Frustum pvp::Frustum::from_matrix(const glm::mat4& projection_view)
+{
+    const glm::mat4 rows = glm::transpose(projection_view);
+
+    // The near plane uses -w <= z so it holds for both depth ranges, it only lets through a little more for [0, 1]
+    Frustum frustum{ .planes = {
+                         rows[3] + rows[0],
+                         rows[3] - rows[0],
+                         rows[3] + rows[1],
+                         rows[3] - rows[1],
+                         rows[3] + rows[2],
+                         rows[3] - rows[2],
+                     } };
+    for (glm::vec4& plane : frustum.planes)
+    {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return frustum;
+}
+
+void pvp::SceneBvh::build(std::span<const Aabb> item_bounds)
+{
+    ZoneScoped;
+    clear();
+    if (item_bounds.empty())
+    {
+        return;
+    }
+
+    m_item_bounds.assign(item_bounds.begin(), item_bounds.end());
+    m_items.resize(item_bounds.size());
+    std::iota(m_items.begin(), m_items.end(), 0u);
+
+    std::vector<glm::vec3> centers(item_bounds.size());
+    std::ranges::transform(item_bounds, centers.begin(), &Aabb::center);
+
+    m_nodes.reserve(item_bounds.size() * 2);
+    m_nodes.push_back(Node{ .first = 0, .count = static_cast<uint32_t>(item_bounds.size()) });
+
+    std::vector<uint32_t> stack{ 0 };
+    while (!stack.empty())
+    {
+        const uint32_t node_index = stack.back();
+        stack.pop_back();
+        const uint32_t first = m_nodes[node_index].first;
+        const uint32_t count = m_nodes[node_index].count;
+
+        Aabb bounds{};
+        Aabb center_bounds{};
+        for (uint32_t i = first; i < first + count; ++i)
+        {
+            bounds.grow(m_item_bounds[m_items[i]]);
+            center_bounds.grow(centers[m_items[i]]);
+        }
+        m_nodes[node_index].bounds = bounds;
+
+        if (count <= max_leaf_items)
+        {
+            continue;
+        }
+
+        // Surface area heuristic evaluated at the borders between bin_count equal slices of the centers
+        float    best_cost = std::numeric_limits<float>::max();
+        int      best_axis = -1;
+        uint32_t best_split{};
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            const float extent = center_bounds.max[axis] - center_bounds.min[axis];
+            if (extent <= 0.0f)
+            {
+                continue;
+            }
+            const float scale = static_cast<float>(bin_count) / extent;
+
+            std::array<Aabb, bin_count>     bin_bounds{};
+            std::array<uint32_t, bin_count> bin_items{};
+            for (uint32_t i = first; i < first + count; ++i)
+            {
+                const uint32_t bin = std::min(static_cast<uint32_t>((centers[m_items[i]][axis] - center_bounds.min[axis]) * scale), bin_count - 1);
+                bin_bounds[bin].grow(m_item_bounds[m_items[i]]);
+                ++bin_items[bin];
+            }
+
+            std::array<float, bin_count> left_cost{};
+            Aabb                         left{};
+            uint32_t                     left_items{};
+            for (uint32_t bin = 0; bin < bin_count - 1; ++bin)
+            {
+                left.grow(bin_bounds[bin]);
+                left_items += bin_items[bin];
+                left_cost[bin] = left_items == 0 ? std::numeric_limits<float>::max() : left.surface_area() * static_cast<float>(left_items);
+            }
+
+            Aabb     right{};
+            uint32_t right_items{};
+            for (uint32_t bin = bin_count - 1; bin > 0; --bin)
+            {
+                right.grow(bin_bounds[bin]);
+                right_items += bin_items[bin];
+                if (right_items == 0 || left_cost[bin - 1] == std::numeric_limits<float>::max())
+                {
+                    continue;
+                }
+                const float cost = left_cost[bin - 1] + right.surface_area() * static_cast<float>(right_items);
+                if (cost < best_cost)
+                {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_split = bin;
+                }
+            }
+        }
+
+        // Every center in the same spot, nothing to split on
+        if (best_axis < 0)
+        {
+            continue;
+        }
+
+        const float scale = static_cast<float>(bin_count) / (center_bounds.max[best_axis] - center_bounds.min[best_axis]);
+        const auto  middle = std::partition(m_items.begin() + first, m_items.begin() + first + count, [&](uint32_t item) {
+            return std::min(static_cast<uint32_t>((centers[item][best_axis] - center_bounds.min[best_axis]) * scale), bin_count - 1) < best_split;
+        });
+        const uint32_t left_count = static_cast<uint32_t>(middle - (m_items.begin() + first));
+
+        const uint32_t left_index = static_cast<uint32_t>(m_nodes.size());
+        m_nodes.push_back(Node{ .first = first, .count = left_count });
+        m_nodes.push_back(Node{ .first = first + left_count, .count = count - left_count });
+        m_nodes[node_index].first = left_index;
+        m_nodes[node_index].count = 0;
+        stack.push_back(left_index);
+        stack.push_back(left_index + 1);
+    }
+}
+
+void pvp::SceneBvh::clear()
+{
+    m_nodes.clear();
+    m_items.clear();
+    m_item_bounds.clear();
+}
+
+void pvp::SceneBvh::query_frustum(const Frustum& frustum, std::vector<uint32_t>& items_out) const
+{
+    ZoneScoped;
+    items_out.clear();
+    if (m_nodes.empty())
+    {
+        return;
+    }
+
+    std::vector<uint32_t> stack{ 0 };
+    while (!stack.empty())
+    {
+        const Node& node = m_nodes[stack.back()];
+        stack.pop_back();
+        if (!intersects(frustum, node.bounds))
+        {
+            continue;
+        }
+
+        if (node.count == 0)
+        {
+            stack.push_back(node.first);
+            stack.push_back(node.first + 1);
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; ++i)
+        {
+            if (intersects(frustum, m_item_bounds[m_items[i]]))
+            {
+                items_out.push_back(m_items[i]);
+            }
+        }
+    }
+}
+
+void pvp::SceneBvh::query_nearest(const glm::vec3& point, size_t count, std::vector<uint32_t>& items_out) const
+{
+    ZoneScoped;
+    items_out.clear();
+    if (m_nodes.empty() || count == 0)
+    {
+        return;
+    }
+
+    // Nodes nearest first, found items as a max heap so the furthest of them is the one to replace
+    using Entry = std::pair<float, uint32_t>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<>> nodes;
+    std::priority_queue<Entry>                                     found;
+    nodes.emplace(distance_squared(m_nodes[0].bounds, point), 0);
+
+    while (!nodes.empty())
+    {
+        const auto [node_distance, node_index] = nodes.top();
+        nodes.pop();
+        if (found.size() == count && node_distance >= found.top().first)
+        {
+            break;
+        }
+
+        const Node& node = m_nodes[node_index];
+        if (node.count == 0)
+        {
+            nodes.emplace(distance_squared(m_nodes[node.first].bounds, point), node.first);
+            nodes.emplace(distance_squared(m_nodes[node.first + 1].bounds, point), node.first + 1);
+            continue;
+        }
+
+        for (uint32_t i = node.first; i < node.first + node.count; ++i)
+        {
+            const float distance = distance_squared(m_item_bounds[m_items[i]], point);
+            if (found.size() < count)
+            {
+                found.emplace(distance, m_items[i]);
+            }
+            else if (distance < found.top().first)
+            {
+                found.pop();
+                found.emplace(distance, m_items[i]);
+            }
+        }
+    }
+
+    items_out.resize(found.size());
+    for (size_t i = found.size(); i-- > 0;)
+    {
+        items_out[i] = found.top().second;
+        found.pop();
+    }
+}
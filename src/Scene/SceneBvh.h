@@ -0,0 +1,75 @@
+﻿#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+namespace pvp
+{
+    struct Aabb
+    {
+        glm::vec3 min{ std::numeric_limits<float>::max() };
+        glm::vec3 max{ std::numeric_limits<float>::lowest() };
+
+        void grow(const glm::vec3& point);
+        void grow(const Aabb& other);
+
+        // Box around the eight transformed corners
+        [[nodiscard]] Aabb      transformed(const glm::mat4& matrix) const;
+        [[nodiscard]] glm::vec3 center() const;
+        [[nodiscard]] float     surface_area() const;
+        [[nodiscard]] bool      empty() const;
+    };
+
+    // Planes point inwards, xyz normal and w distance. Built from a projection view matrix
+    struct Frustum
+    {
+        std::array<glm::vec4, 6> planes;
+
+        static Frustum from_matrix(const glm::mat4& projection_view);
+    };
+
+    // Bounding volume hierarchy over item boxes, built with binned SAH. Items are the indices into the span passed to
+    // build. Knows nothing about Vulkan so it can be built and timed on its own, see pvp-bvh-bench.
+    class SceneBvh final
+    {
+    public:
+        void build(std::span<const Aabb> item_bounds);
+        void clear();
+
+        // Items whose box is at least partly inside, in tree order
+        void query_frustum(const Frustum& frustum, std::vector<uint32_t>& items_out) const;
+        // Up to count items ordered by the distance from point to their box, nearest first
+        void query_nearest(const glm::vec3& point, size_t count, std::vector<uint32_t>& items_out) const;
+
+        [[nodiscard]] size_t size() const
+        {
+            return m_items.size();
+        }
+        [[nodiscard]] size_t node_count() const
+        {
+            return m_nodes.size();
+        }
+
+    private:
+        // Leaves have a count, their items are m_items[first, first + count). Inner nodes have the children first and first + 1
+        struct Node
+        {
+            Aabb     bounds;
+            uint32_t first;
+            uint32_t count;
+        };
+
+        std::vector<Node>     m_nodes;
+        std::vector<uint32_t> m_items;       // Item indices, leaves own contiguous ranges
+        std::vector<Aabb>     m_item_bounds; // By item index
+
+        constexpr static uint32_t bin_count{ 16 };
+        constexpr static uint32_t max_leaf_items{ 4 };
+    };
+} // namespace pvp
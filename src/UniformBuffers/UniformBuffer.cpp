@@ -1,8 +1,11 @@
 ﻿#include "UniformBuffer.h"
 
+#include <Buffer/BufferPool.h>
+#include <VMAAllocator/VmaAllocator.h>
+
 namespace pvp
 {
-    UniformBuffer::UniformBuffer(size_t size, const VmaAllocator& allocator)
+    UniformBuffer::UniformBuffer(size_t size, PvpVmaAllocator& allocator)
     {
         m_buffers.resize(max_frames_in_flight);
         for (int i = 0; i < max_frames_in_flight; ++i)
@@ -12,7 +15,8 @@ namespace pvp
                 .set_usage(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
                 .set_flags(VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT)
                 .set_memory_usage(VMA_MEMORY_USAGE_AUTO)
-                .build(allocator, m_buffers[i]);
+                .set_pool(allocator.get_host_pool())
+                .build(allocator.get_allocator(), m_buffers[i]);
         }
     }
 
@@ -6,11 +6,14 @@
 
 namespace pvp
 {
+    class PvpVmaAllocator;
+
+    // One small buffer per frame in flight, suballocated from the allocator's host pool
     class UniformBuffer
     {
     public:
         explicit UniformBuffer() = default;
-        explicit UniformBuffer(size_t size, const VmaAllocator& allocator);
+        explicit UniformBuffer(size_t size, PvpVmaAllocator& allocator);
         ~UniformBuffer();
 
         DISABLE_COPY(UniformBuffer);
@@ -3,14 +3,26 @@
 #include "../Context/Device.h"
 #include "../Context/Instance.h"
 #include "../Context/PhysicalDevice.h"
+#include <Buffer/BufferPool.h>
 #include <tracy/Tracy.hpp>
 
 const VmaAllocator& pvp::PvpVmaAllocator::get_allocator() const
 {
     return m_allocator;
 }
+pvp::BufferPool& pvp::PvpVmaAllocator::get_device_pool() const
+{
+    return *m_device_pool;
+}
+pvp::BufferPool& pvp::PvpVmaAllocator::get_host_pool() const
+{
+    return *m_host_pool;
+}
 pvp::PvpVmaAllocator::~PvpVmaAllocator()
 {
+    m_device_pool.reset();
+    m_host_pool.reset();
+
     // char* statsString = nullptr;
     // vmaBuildStatsString(m_allocator, &statsString, VK_FALSE); // VK_TRUE for detailed info
     // printf("VMA Stats:\n%s\n", statsString);
@@ -29,4 +41,20 @@ void pvp::create_allocator(PvpVmaAllocator& allocator, const pvp::Instance& inst
     allocator_info.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
 
     vmaCreateAllocator(&allocator_info, &allocator.m_allocator);
+
+    allocator.m_device_pool = std::make_unique<BufferPool>(allocator.m_allocator,
+                                                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                                                               VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                                                               VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                                                               VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                                           VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+                                                           0,
+                                                           PvpVmaAllocator::device_pool_block_size);
+    allocator.m_host_pool = std::make_unique<BufferPool>(allocator.m_allocator,
+                                                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                                                             VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                                             VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                                         VMA_MEMORY_USAGE_AUTO,
+                                                         VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+                                                         PvpVmaAllocator::host_pool_block_size);
 }
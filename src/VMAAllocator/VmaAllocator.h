@@ -1,5 +1,6 @@
 ﻿#pragma once
 
+#include <memory>
 #include <vma/vk_mem_alloc.h>
 
 namespace pvp
@@ -7,16 +8,26 @@ namespace pvp
     class PhysicalDevice;
     class Device;
     class Instance;
+    class BufferPool;
 
     class PvpVmaAllocator
     {
     public:
         [[nodiscard]] const VmaAllocator& get_allocator() const;
+        // Shared pools for small buffers, see BufferBuilder::set_pool. Device local ones are written by copies
+        [[nodiscard]] BufferPool& get_device_pool() const;
+        // Persistently mapped and written by the CPU
+        [[nodiscard]] BufferPool& get_host_pool() const;
         ~PvpVmaAllocator();
 
     private:
-        friend void  create_allocator(PvpVmaAllocator& allocator, const pvp::Instance& instance, const pvp::Device& device, const pvp::PhysicalDevice& physical_device);
-        VmaAllocator m_allocator{ VK_NULL_HANDLE };
+        friend void                 create_allocator(PvpVmaAllocator& allocator, const pvp::Instance& instance, const pvp::Device& device, const pvp::PhysicalDevice& physical_device);
+        VmaAllocator                m_allocator{ VK_NULL_HANDLE };
+        std::unique_ptr<BufferPool> m_device_pool;
+        std::unique_ptr<BufferPool> m_host_pool;
+
+        constexpr static VkDeviceSize device_pool_block_size{ 16 * 1024 * 1024 };
+        constexpr static VkDeviceSize host_pool_block_size{ 4 * 1024 * 1024 };
     };
 
     void create_allocator(PvpVmaAllocator& allocator, const pvp::Instance& instance, const pvp::Device& device, const pvp::PhysicalDevice& physical_device);
@@ -10,6 +10,9 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#define RGBCX_IMPLEMENTATION
+#include <rgbcx.h>
+
 // Easy memory leak detector.
 #if WIN32
 #define _CRTDBG_MAP_ALLOC